@@ -1,17 +1,23 @@
 #pragma once
+#include <stddef.h>
 #include <stdint.h>
 
 typedef struct Type Type;
 typedef struct Member Member;
 typedef struct Token Token;
 
+// every file content is followed by at least this many zero bytes
+#define SOURCE_PADDING 64
+
 typedef struct File {
     char *name;
     char *content;
+    size_t size;
 } File;
 
-char *read_file(const char *path);
-File *new_file(char *name, char *contents);
+char *read_file(const char *path, size_t *size);
+void unmap_file(char *content, size_t size);
+File *new_file(char *name, char *contents, size_t size);
 
 typedef enum TokenKind {
     Tok_Eof,
@@ -19,6 +25,7 @@ typedef enum TokenKind {
     Tok_Identifier,
     Tok_StringLiteral,
     Tok_NumberLiteral,
+    Tok_FloatLiteral,
     Tok_Equal,
     Tok_EqualEqual,
     Tok_Plus,
@@ -58,6 +65,14 @@ typedef enum TokenKind {
     Tok_GreaterOrEqual,
     Tok_ShiftRight,
     Tok_ShiftLeft,
+    Tok_Keyword_fn,
+    Tok_Keyword_pub,
+    Tok_Keyword_const,
+    Tok_Keyword_var,
+    Tok_Keyword_return,
+    Tok_Keyword_if,
+    Tok_Keyword_for,
+    Tok_Keyword_while,
 } TokenKind;
 
 struct Token {
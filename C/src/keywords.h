@@ -0,0 +1,24 @@
+#pragma once
+#include "../../shared/keywords.h"
+#include "compiler.h"
+#include <string.h>
+
+// Keywords are found with a perfect hash over (first byte, last byte, length), the hash
+// and the keyword list are shared/keywords.h, the same ones the Cpp lexer uses.
+// The switch below is the table: a collision shows up as a duplicate case label.
+
+// `len` must be > 0
+static inline TokenKind keyword_kind(const char *s, int len) {
+    switch (KEYWORD_HASH(s[0], s[len - 1], len)) {
+#define X(text, kind, first, last)                                             \
+    case KEYWORD_HASH(first, last, sizeof(text) - 1):                          \
+        if (len == sizeof(text) - 1 && memcmp(s, text, len) == 0)              \
+            return kind;                                                       \
+        break;
+        KEYWORD_LIST(X)
+#undef X
+    default:
+        break;
+    }
+    return Tok_Identifier;
+}
@@ -23,11 +23,16 @@ int main(int argc, char **argv) {
         exit(0);
     }
 
-    char *source = read_file(argv[1]);
-	auto file = new_file(argv[1], source);
+    size_t size = 0;
+    char *source = read_file(argv[1], &size);
+    if (!source) {
+        fprintf(stderr, "Error: failed to open file {%s}\n", argv[1]);
+        exit(1);
+    }
+	auto file = new_file(argv[1], source, size);
 
     auto tokens = tokenize(file);
 	print_tokens(tokens);
-	utils_free(source);
+	unmap_file(source, size);
     return 0;
 }
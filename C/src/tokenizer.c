@@ -1,12 +1,20 @@
+// mremap
+#define _GNU_SOURCE
+#include "../../shared/number.h"
 #include "compiler.h"
+#include "keywords.h"
 #include "utils.h"
 #include <ctype.h>
+#include <fcntl.h>
 #include <memory.h>
 #include <stdbool.h>
 #include <stddef.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
 
 #define is_digit                                                               \
     '0' : case '1':                                                            \
@@ -74,30 +82,69 @@
 
 static File *current_file;
 
-char *read_file(const char *path) {
-    FILE *fp = fopen(path, "r");
-	if(!fp)
-		return NULL;
-	
-	fseek(fp, 0, SEEK_END);
-	auto flen = ftell(fp);
-	fseek(fp, 0, SEEK_SET);
-
-	char* buffer = malloc(flen+1);
-	if(!buffer)
-	{
-		fprintf(stderr, "Error:Couldn't allocate memory for file buffer\n");
-		exit(1);
-	}
-	fread(buffer, 1, flen, fp);
+static size_t round_to_pages(size_t size) {
+    size_t page = (size_t)sysconf(_SC_PAGESIZE);
+    return (size + page - 1) / page * page;
+}
+
+// Regular files are mapped over the front of a zeroed anonymous reservation
+// that is SOURCE_PADDING bytes longer, pipes and stdin ("-") are read into one.
+// Either way the content is NUL terminated and can be read past its end.
+char *read_file(const char *path, size_t *size) {
+    bool is_stdin = strcmp(path, "-") == 0;
+    int fd = is_stdin ? STDIN_FILENO : open(path, O_RDONLY);
+    if (fd < 0)
+        return NULL;
+
+    struct stat st;
+    char *buffer = NULL;
+    if (fstat(fd, &st) == 0 && S_ISREG(st.st_mode)) {
+        *size = (size_t)st.st_size;
+        buffer = mmap(NULL, round_to_pages(*size + SOURCE_PADDING), PROT_READ,
+                      MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (buffer != MAP_FAILED && *size > 0 &&
+            mmap(buffer, *size, PROT_READ, MAP_PRIVATE | MAP_FIXED, fd, 0) ==
+                MAP_FAILED) {
+            munmap(buffer, round_to_pages(*size + SOURCE_PADDING));
+            buffer = MAP_FAILED;
+        }
+    } else {
+        size_t capacity = round_to_pages(64 * 1024);
+        *size = 0;
+        buffer = mmap(NULL, capacity, PROT_READ | PROT_WRITE,
+                      MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        while (buffer != MAP_FAILED) {
+            if (capacity - *size < SOURCE_PADDING) {
+                buffer = mremap(buffer, capacity, capacity * 2, MREMAP_MAYMOVE);
+                capacity *= 2;
+                continue;
+            }
+            ssize_t n =
+                read(fd, buffer + *size, capacity - *size - SOURCE_PADDING);
+            if (n <= 0)
+                break;
+            *size += (size_t)n;
+        }
+    }
+    if (!is_stdin)
+        close(fd);
 
+    if (buffer == MAP_FAILED) {
+        fprintf(stderr, "Error:Couldn't map memory for file buffer\n");
+        exit(1);
+    }
     return buffer;
 }
 
-File *new_file(char *name, char *contents) {
+void unmap_file(char *content, size_t size) {
+    munmap(content, round_to_pages(size + SOURCE_PADDING));
+}
+
+File *new_file(char *name, char *contents, size_t size) {
     File *file = (File *)calloc(1, sizeof(File));
     file->name = name;
     file->content = contents;
+    file->size = size;
     return file;
 }
 
@@ -178,6 +225,8 @@ const char *token_type_str(TokenKind type) {
         return "StringLiteral";
     case Tok_NumberLiteral:
         return "NumberLiteral";
+    case Tok_FloatLiteral:
+        return "FloatLiteral";
     case Tok_Equal:
         return "Equal";
     case Tok_EqualEqual:
@@ -256,6 +305,22 @@ const char *token_type_str(TokenKind type) {
         return "ShiftRight";
     case Tok_ShiftLeft:
         return "ShiftLeft";
+    case Tok_Keyword_fn:
+        return "Keyword_fn";
+    case Tok_Keyword_pub:
+        return "Keyword_pub";
+    case Tok_Keyword_const:
+        return "Keyword_const";
+    case Tok_Keyword_var:
+        return "Keyword_var";
+    case Tok_Keyword_return:
+        return "Keyword_return";
+    case Tok_Keyword_if:
+        return "Keyword_if";
+    case Tok_Keyword_for:
+        return "Keyword_for";
+    case Tok_Keyword_while:
+        return "Keyword_while";
 
     default:
         {
@@ -312,13 +377,21 @@ Token *tokenize(File *file) {
             break;
         case is_digit:
             {
-                char *start = p++;
-                while (isdigit(*p) || *p == '_') {
-                    p++;
-                    col++;
-                }
-                current = current->next =
-                    new_token(Tok_NumberLiteral, start, p);
+                char *start = p;
+                NumberParse num = parse_number(p);
+                p += num.len;
+                col += num.len - 1;
+                // too large or running into letters (`12ab`): one Invalid token
+                // over all of it, like the Cpp lexer makes
+                TokenKind kind = Tok_Invalid;
+                if (num.kind == Number_Int)
+                    kind = Tok_NumberLiteral;
+                if (num.kind == Number_Float)
+                    kind = Tok_FloatLiteral;
+                current = current->next = new_token(kind, start, p);
+                current->value = num.kind == Number_Int ? (int64_t)num.bits : 0;
+                current->fvalue =
+                    num.kind == Number_Float ? num_bits_to_double(num.bits) : 0;
                 current->column = col;
                 current->line = line;
                 continue;
@@ -333,7 +406,8 @@ Token *tokenize(File *file) {
                     p++;
                     col++;
                 }
-                current = current->next = new_token(Tok_Identifier, start, p);
+                current = current->next =
+                    new_token(keyword_kind(start, p - start), start, p);
                 current->column = col;
                 current->line = line;
                 continue;
@@ -0,0 +1,1229 @@
+#include "../src/ast_cache.h"
+#include "../src/format.h"
+#include "../src/lexer.h"
+#include "../src/number.h"
+#include "../src/out_buffer.h"
+#include "../src/parser.h"
+#include "../src/scan.h"
+#include "../src/visit.h"
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <fcntl.h>
+#include <new>
+#include <stdlib.h>
+#include <string.h>
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <sys/wait.h>
+#include <thread>
+#include <unistd.h>
+#include <unordered_map>
+
+// every allocation made by the frontend goes through here, so the numbers below
+// are exact and don't depend on the libc malloc statistics
+static size_t alloc_count = 0;
+static size_t alloc_bytes = 0;
+
+void* operator new(size_t size) {
+    alloc_count++;
+    alloc_bytes += size;
+    if (void* ptr = malloc(size)) return ptr;
+    abort();
+}
+void operator delete(void* ptr) noexcept { free(ptr); }
+void operator delete(void* ptr, size_t) noexcept { free(ptr); }
+
+using Clock = std::chrono::steady_clock;
+
+static double elapsed_ms(Clock::time_point start) {
+    return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+}
+
+// writes `count` functions of generated code, shaped like test/main.drg
+static void gen_source(long count, bool comments) {
+    printf("const def = 2334;\n\n");
+    for (long i = 0; i < count; i++) {
+        if (comments) {
+            printf("/// Generated function number %ld.\n", i);
+            printf("/// Returns the value it computed, or whatever is left in `value`\n");
+            printf("/// when the loop below is done with it.\n");
+            printf("/* generator: bench/main.c, template: func, seed: %ld, options: none */\n", i);
+        }
+        printf("fn func_%ld(argc: int, argument_vector_list: []str) -> int {\n", i);
+        if (comments) printf("\t// start from the index so every function differs a bit\n");
+        printf("\tvar value: int = %ld + argc * 3 - 14 / 2;\n", i);
+        printf("\tif value < 100 {\n");
+        printf("\t\tprintf(\"value is %%d\", value);\n");
+        printf("\t}\n");
+        printf("\tfor value < 3 {\n");
+        printf("\t\tvalue = value + 1;\n");
+        printf("\t}\n");
+        printf("\tresult.field = value;\n");
+        printf("}\n\n");
+    }
+}
+
+static void bench_tokens(string_view source) {
+    size_t count_before = alloc_count;
+    size_t bytes_before = alloc_bytes;
+    auto start = Clock::now();
+
+    TokenList tokens = tokenize(source);
+    double ms = elapsed_ms(start);
+
+    double n = (double)tokens.size();
+    size_t stored = tokens.kinds.capacity() * sizeof(uint8_t) +
+                    tokens.starts.capacity() * sizeof(ByteOffset) +
+                    tokens.literal_tokens.capacity() * sizeof(TokenIndex) +
+                    tokens.literal_values.capacity() * sizeof(uint64_t);
+    printf("tokens          : %u\n", tokens.size());
+    printf("bytes per token : %zu stored, sizeof(Token) = %zu when materialized\n",
+           sizeof(uint8_t) + sizeof(ByteOffset), sizeof(Token));
+    printf("token storage   : %zu bytes (%.1f per token, incl. literals and reserve slack)\n",
+           stored, stored / n);
+    printf("allocations     : %zu (%.3f per token)\n", alloc_count - count_before,
+           (alloc_count - count_before) / n);
+    printf("allocated bytes : %zu (%.1f per token)\n", alloc_bytes - bytes_before,
+           (alloc_bytes - bytes_before) / n);
+    printf("lex time        : %.2f ms (%.1f MB/s)\n", ms, source.size() / (ms * 1000.0));
+
+    start = Clock::now();
+    LineTable lines(source);
+    ms = elapsed_ms(start);
+    printf("line table      : %zu lines, built in %.2f ms\n", lines.line_starts.size(), ms);
+}
+
+// full lexer throughput with each character class kernel set the cpu supports
+static void bench_scan(string_view source) {
+    const int rounds = 5;
+    {
+        // reference point: how fast can we just find every newline
+        double best = 1e30;
+        size_t lines = 0;
+        for (int i = 0; i < rounds; i++) {
+            auto start = Clock::now();
+            lines = 0;
+            const char* end = source.data() + source.size();
+            for (const char* p = source.data(); (p = (const char*)memchr(p, '\n', end - p)); p++)
+                lines++;
+            double ms = elapsed_ms(start);
+            if (ms < best) best = ms;
+        }
+        printf("%-7s: %8.1f MB/s  (%zu lines, best of %d)\n", "memchr", source.size() / (best * 1000.0),
+               lines, rounds);
+    }
+    for (ScanPath path : {Scan_Scalar, Scan_SSE2, Scan_AVX2}) {
+        if (!scan_use_path(path)) {
+            printf("%-7s: not supported\n", enum_to_str(path));
+            continue;
+        }
+        double best = 1e30;
+        size_t count = 0;
+        for (int i = 0; i < rounds; i++) {
+            auto start = Clock::now();
+            Lexer lexer(source);
+            count = 0;
+            while (lexer.next_token().kind != Tok_Eof) count++;
+            double ms = elapsed_ms(start);
+            if (ms < best) best = ms;
+        }
+        printf("%-7s: %8.1f MB/s  (%zu tokens, best of %d)\n", enum_to_str(path),
+               source.size() / (best * 1000.0), count, rounds);
+    }
+}
+
+static auto kernels_agree(const char* src, uint32_t size, Utf8Scan expected) -> bool {
+    bool same = true;
+    for (ScanPath path : {Scan_SSE2, Scan_AVX2}) {
+        if (!scan_use_path(path)) continue;
+        Utf8Scan got = scan_kernels->validate_utf8(src, 0, size);
+        same &= got.error == expected.error && got.ascii == expected.ascii;
+    }
+    return same;
+}
+
+// UTF-8 validation MB/s for each path, then random byte soup checked against the scalar path
+static void bench_utf8(string_view source, int fuzz_rounds) {
+    const int rounds = 5;
+    Utf8Scan expected = {};
+    for (ScanPath path : {Scan_Scalar, Scan_SSE2, Scan_AVX2}) {
+        if (!scan_use_path(path)) {
+            printf("%-7s: not supported\n", enum_to_str(path));
+            continue;
+        }
+        double best = 1e30;
+        Utf8Scan result = {};
+        for (int i = 0; i < rounds; i++) {
+            auto start = Clock::now();
+            result = scan_kernels->validate_utf8(source.data(), 0, source.size());
+            double ms = elapsed_ms(start);
+            if (ms < best) best = ms;
+        }
+        if (path == Scan_Scalar) expected = result;
+        bool valid = result.error == source.size();
+        printf("%-7s: %8.1f MB/s  (%s%s)\n", enum_to_str(path), source.size() / (best * 1000.0),
+               valid ? "valid" : "invalid", result.ascii ? ", ascii" : "");
+        if (result.error != expected.error || result.ascii != expected.ascii) {
+            printf("MISMATCH with the scalar path\n");
+            exit(1);
+        }
+    }
+
+    // valid sequences of every length, plus the usual suspects: stray continuations,
+    // overlongs, surrogates, > U+10FFFF, truncated leads
+    static const char* pieces[] = {
+        "a",        "fn x",         "\n",
+        "\xC3\xA9",     "\xE2\x82\xAC", "\xF0\x9F\x98\x80",
+        "\xF4\x8F\xBF\xBF", // U+10FFFF, the last valid one
+        "\x80",        "\xBF",         "\xC0\xAF",
+        "\xC1\xBF",     "\xE0\x80\xAF", "\xED\xA0\x80",
+        "\xF4\x90\x80\x80", "\xF5\x80\x80\x80", "\xF8",
+        "\xC3",        "\xE2\x82",     "\xF0\x9F\x98",
+    };
+    constexpr int piece_count = sizeof(pieces) / sizeof(pieces[0]);
+    srand(99);
+    int invalid = 0;
+    for (int i = 0; i < fuzz_rounds; i++) {
+        string text;
+        int pieces_in = rand() % 64;
+        for (int j = 0; j < pieces_in; j++) {
+            // mostly valid text, so errors land at every offset
+            int k = rand() % 8 ? rand() % 7 : rand() % piece_count;
+            text += pieces[k];
+        }
+        uint32_t size = text.size();
+        text.append(source_padding, '\0');
+        scan_use_path(Scan_Scalar);
+        Utf8Scan want = scan_kernels->validate_utf8(text.data(), 0, size);
+        invalid += want.error != size;
+        if (!kernels_agree(text.data(), size, want)) {
+            printf("MISMATCH on fuzz input %d (%u bytes)\n", i, size);
+            exit(1);
+        }
+    }
+    printf("fuzz   : %d inputs (%d invalid), all paths agree\n", fuzz_rounds, invalid);
+}
+
+// through start() and literal_token(), relex() may still owe either of them a shift
+static auto same_tokens(const TokenList& a, const TokenList& b) -> bool {
+    if (a.kinds != b.kinds || a.literal_values != b.literal_values) return false;
+    for (TokenIndex i = 0; i < a.size(); i++) {
+        if (a.start(i) != b.start(i)) return false;
+    }
+    for (uint32_t j = 0; j < a.literal_tokens.size(); j++) {
+        if (a.literal_token(j) != b.literal_token(j)) return false;
+    }
+    return true;
+}
+
+static auto same_comments(const CommentTable& a, const CommentTable& b) -> bool {
+    return std::equal(a.comments.begin(), a.comments.end(), b.comments.begin(),
+                      b.comments.end(), [](const Comment& x, const Comment& y) {
+                          return x.start == y.start && x.len == y.len && x.kind == y.kind;
+                      });
+}
+
+// tokenize_parallel() against tokenize() of the same text, lexed first: the comments have
+// to match, and nothing the chunk lexers guessed at may be left in the pools
+static auto same_as_parallel(string_view source, uint32_t jobs) -> bool {
+    CommentTable expected_comments = {Comments_All, {}};
+    TokenList expected = tokenize(source, &expected_comments);
+    uint32_t names = identifier_pool.size(), strings = string_pool.size();
+    CommentTable comments = {Comments_All, {}};
+    TokenList tokens = tokenize_parallel(source, jobs, &comments);
+    return same_tokens(tokens, expected) && same_comments(comments, expected_comments) &&
+           identifier_pool.size() == names && string_pool.size() == strings;
+}
+
+// sequential vs chunked lexing, also checks both produce the same token list
+static void bench_lex_parallel(string_view source, uint32_t jobs) {
+    auto start = Clock::now();
+    TokenList expected = tokenize(source);
+    double sequential_ms = elapsed_ms(start);
+
+    start = Clock::now();
+    TokenList tokens = tokenize_parallel(source, jobs);
+    double parallel_ms = elapsed_ms(start);
+
+    bool same = same_tokens(tokens, expected) && same_as_parallel(source, jobs);
+    printf("tokens     : %u\n", tokens.size());
+    printf("sequential : %8.2f ms (%.1f MB/s)\n", sequential_ms,
+           source.size() / (sequential_ms * 1000.0));
+    printf("%2u jobs    : %8.2f ms (%.1f MB/s, %.2fx)\n", jobs, parallel_ms,
+           source.size() / (parallel_ms * 1000.0), sequential_ms / parallel_ms);
+    printf("result     : %s\n", same ? "identical (comments and names too)" : "MISMATCH");
+    if (!same) exit(1);
+}
+
+// parseRootParallel() vs parseRoot() on the same tokens, the trees have to be identical
+static void bench_parse_parallel(string_view source, uint32_t jobs) {
+    Parser sequential(source);
+    auto start = Clock::now();
+    sequential.parseRoot();
+    double sequential_ms = elapsed_ms(start);
+
+    Parser parallel(source);
+    start = Clock::now();
+    parallel.parseRootParallel(jobs);
+    double parallel_ms = elapsed_ms(start);
+
+    const Ast& expected = sequential.ast;
+    const Ast& ast = parallel.ast;
+    bool same = ast.tags == expected.tags && ast.main_tokens == expected.main_tokens &&
+                ast.extra_data == expected.extra_data &&
+                memcmp(ast.datas.data(), expected.datas.data(), ast.size() * sizeof(NodeData)) == 0;
+    printf("tokens     : %u, %u nodes, %u threads available\n", sequential.tokens.size(),
+           expected.size(), std::thread::hardware_concurrency());
+    printf("sequential : %8.2f ms\n", sequential_ms);
+    printf("%2u jobs    : %8.2f ms (%.2fx)\n", jobs, parallel_ms, sequential_ms / parallel_ms);
+    printf("result     : %s\n", same ? "identical" : "MISMATCH");
+    if (!same) exit(1);
+}
+
+// random single edits, each relexed incrementally and checked against a full tokenize()
+static void bench_relex(string_view contents, int edits) {
+    // lone quotes and comment markers too, they turn string contents and comments into
+    // code and back, with bytes in them that aren't tokens
+    static const char* snippets[] = {"a",  "1", " ",  "\n",  "\"s\"", "=",  "+=", "fn", "(",
+                                     "->", "2.5", "0x1f", "\"", "'",     "/*", "*/", "//", "\\"};
+    constexpr int snippet_count = sizeof(snippets) / sizeof(snippets[0]);
+    EditableSource source(contents);
+    TokenList tokens = tokenize(source.view());
+    srand(1234);
+
+    double relex_ms = 0, full_ms = 0;
+    uint64_t relexed = 0;
+    for (int i = 0; i < edits; i++) {
+        SourceEdit edit;
+        edit.offset = rand() % (source.size() + 1);
+        edit.removed = rand() % 3 ? 0 : std::min<uint32_t>(rand() % 8, source.size() - edit.offset);
+        edit.inserted = rand() % 4 == 0 ? "" : snippets[rand() % snippet_count];
+        source.apply(edit);
+
+        auto start = Clock::now();
+        TokenEdit result = relex(tokens, source.view(), edit);
+        relex_ms += elapsed_ms(start);
+        relexed += result.inserted;
+
+        start = Clock::now();
+        TokenList expected = tokenize(source.view());
+        full_ms += elapsed_ms(start);
+
+        if (!same_tokens(tokens, expected)) {
+            printf("MISMATCH after edit %d (offset %u, removed %u, inserted `" SV_FMT "`)\n", i,
+                   edit.offset, edit.removed, SV_ARG(edit.inserted));
+            exit(1);
+        }
+    }
+
+    // a line typed near the top a key at a time, only the keys that add a token move
+    // the tail (a memmove), none go over it to shift it
+    const char* line = "count = count * 16 + 1;\n";
+    uint32_t at = std::min<uint32_t>(source.size(), 64), keys = 0;
+    double typing_ms = 0;
+    for (int round = 0; round < 20; round++) {
+        for (const char* key = line; *key; key++, keys++) {
+            SourceEdit edit = {at++, 0, string_view(key, 1)};
+            source.apply(edit);
+            auto start = Clock::now();
+            relex(tokens, source.view(), edit);
+            typing_ms += elapsed_ms(start);
+        }
+    }
+    if (!same_tokens(tokens, tokenize(source.view()))) {
+        printf("MISMATCH after typing at offset %u\n", at);
+        exit(1);
+    }
+    printf("edits          : %d on %u bytes, all identical to a full relex\n", edits,
+           source.size());
+    printf("relexed tokens : %.1f per edit (of %u)\n", (double)relexed / edits, tokens.size());
+    printf("incremental    : %.3f ms per edit\n", relex_ms / edits);
+    printf("full tokenize  : %.3f ms per edit\n", full_ms / edits);
+    printf("typing         : %.3f ms per key, %u keys near the top\n", typing_ms / keys, keys);
+}
+
+// random integer and float literals decoded with parse_number() and with libc,
+// the results must match bit for bit
+static void bench_numbers(long count) {
+    string text;
+    vector<uint32_t> offsets;
+    srand(4321);
+    char buf[64];
+    for (long i = 0; i < count; i++) {
+        uint64_t mantissa = ((uint64_t)rand() << 31 | rand()) >> (rand() % 62);
+        switch (i % 4) {
+        case 0:
+        case 1:
+            snprintf(buf, sizeof(buf), "%llu", (unsigned long long)mantissa);
+            break;
+        case 2:
+            snprintf(buf, sizeof(buf), "%llu.%u", (unsigned long long)(mantissa >> 20),
+                     rand() % 1000);
+            break;
+        case 3:
+            snprintf(buf, sizeof(buf), "%.*e", rand() % 17,
+                     (double)mantissa / 7.0 * pow(10, rand() % 80 - 40));
+            break;
+        }
+        offsets.push_back(text.size());
+        text += buf;
+        text += ' ';
+    }
+    text.append(source_padding, '\0');
+    const char* src = text.data();
+
+    // integers and floats are timed apart, their cost is very different
+    for (int floats = 0; floats < 2; floats++) {
+        auto start = Clock::now();
+        uint64_t sum = 0;
+        for (long i = floats ? 2 : 0; i < count; i += 4) {
+            sum += parse_number(src + offsets[i]).bits + parse_number(src + offsets[i + 1]).bits;
+        }
+        double fast_ms = elapsed_ms(start);
+
+        start = Clock::now();
+        for (long i = floats ? 2 : 0; i < count; i += 4) {
+            const char* p = src + offsets[i];
+            const char* q = src + offsets[i + 1];
+            sum -= floats ? double_to_bits(strtod(p, nullptr)) + double_to_bits(strtod(q, nullptr))
+                          : strtoull(p, nullptr, 10) + strtoull(q, nullptr, 10);
+        }
+        double libc_ms = elapsed_ms(start);
+        double per = 1e6 / (count / 2);
+        printf("%-6s : parse_number %6.1f ns, %s %6.1f ns per literal%s\n",
+               floats ? "floats" : "ints", fast_ms * per, floats ? "strtod  " : "strtoull",
+               libc_ms * per, sum ? " (checksum differs)" : "");
+    }
+
+    for (long i = 0; i < count; i++) {
+        const char* p = src + offsets[i];
+        NumberParse num = parse_number(p);
+        bool is_int = i % 4 < 2;
+        uint64_t expected = is_int ? strtoull(p, nullptr, 10) : double_to_bits(strtod(p, nullptr));
+        if (num.bits != expected || num.kind != (is_int ? Number_Int : Number_Float)) {
+            printf("MISMATCH on `%.*s`\n", (int)strcspn(p, " "), p);
+            exit(1);
+        }
+    }
+    printf("%ld literals, all identical to strtoull / strtod\n", count);
+}
+
+// the obvious one character at a time decoder, to check the lexer against
+static auto reference_decode(string_view text) -> string {
+    string out;
+    for (size_t i = 1; i + 1 < text.size(); i++) {
+        if (text[i] != '\\') {
+            out += text[i];
+            continue;
+        }
+        uint32_t len = decode_escape(text.data() + i, &out);
+        i += len - 1;
+    }
+    return out;
+}
+
+// string literal pool: how much deduplication saves and what decoding costs the lexer
+static void bench_strings(string_view source) {
+    const int rounds = 5;
+    double plain_ms = 1e30, pooled_ms = 1e30;
+    for (int i = 0; i < rounds; i++) {
+        for (StringPool* pool : {(StringPool*)nullptr, &string_pool}) {
+            auto start = Clock::now();
+            Lexer lexer(source);
+            lexer.strings = pool;
+            while (lexer.next_token().kind != Tok_Eof) {}
+            double& best = pool ? pooled_ms : plain_ms;
+            best = std::min(best, elapsed_ms(start));
+        }
+    }
+
+    TokenList tokens = tokenize(source);
+    size_t literals = 0, literal_bytes = 0;
+    for (uint32_t i = 0; i < tokens.literal_tokens.size(); i++) {
+        TokenIndex token = tokens.literal_token(i);
+        if (tokens.kind(token) != Tok_StringLiteral) continue;
+        string_view text = Lexer::token_at(source, tokens.start(token)).buf;
+        string_view decoded = string_pool.get(tokens.literal_values[i]);
+        if (decoded != reference_decode(text)) {
+            printf("MISMATCH on " SV_FMT "\n", SV_ARG(text));
+            exit(1);
+        }
+        literals++;
+        literal_bytes += decoded.size();
+    }
+    printf("string literals : %zu, %zu decoded bytes, all match the reference decoder\n",
+           literals, literal_bytes);
+    printf("pool            : %u distinct strings, %zu bytes\n", string_pool.size(),
+           string_pool.bytes());
+    printf("lex, escapes checked only : %.2f ms\n", plain_ms);
+    printf("lex, decoded and pooled   : %.2f ms\n", pooled_ms);
+}
+
+// identifier interning throughput against thread count. Every thread interns its own
+// slice of the file's identifiers, first into an empty interner and then again once
+// they're all there, the second pass is what lexing looks like after the first file.
+static void bench_intern(string_view source, uint32_t max_threads) {
+    vector<string_view> names;
+    Lexer lexer(source);
+    for (Token tok = lexer.next_token(); tok.kind != Tok_Eof; tok = lexer.next_token()) {
+        if (tok.kind == Tok_Identifier) names.push_back(tok.buf);
+    }
+    vector<SymbolId> ids(names.size());
+
+    auto run = [&](Interner& pool, uint32_t threads, std::mutex* lock) {
+        auto start = Clock::now();
+        vector<std::thread> workers;
+        for (uint32_t t = 0; t < threads; t++) {
+            workers.emplace_back([&, t] {
+                size_t begin = names.size() * t / threads, end = names.size() * (t + 1) / threads;
+                for (size_t i = begin; i < end; i++) {
+                    if (lock) {
+                        std::lock_guard<std::mutex> guard(*lock);
+                        ids[i] = pool.intern(names[i]);
+                    } else {
+                        ids[i] = pool.intern(names[i]);
+                    }
+                }
+            });
+        }
+        for (auto& worker : workers) worker.join();
+        return names.size() / (elapsed_ms(start) * 1000.0);
+    };
+
+    printf("%zu identifiers, M names/s\n", names.size());
+    printf("threads   empty pool   full pool   full pool, one lock\n");
+    for (uint32_t threads = 1; threads <= max_threads; threads *= 2) {
+        Interner* pool = new Interner;
+        std::mutex lock;
+        double cold = run(*pool, threads, nullptr);
+        double warm = run(*pool, threads, nullptr);
+        double locked = run(*pool, threads, &lock);
+
+        // equal names got equal ids, different names different ones
+        std::unordered_map<string_view, SymbolId> seen;
+        for (size_t i = 0; i < names.size(); i++) {
+            auto [it, added] = seen.emplace(names[i], ids[i]);
+            if (it->second != ids[i] || pool->get(ids[i]) != names[i]) {
+                printf("MISMATCH on " SV_FMT "\n", SV_ARG(names[i]));
+                exit(1);
+            }
+        }
+        if (seen.size() != pool->size()) {
+            printf("MISMATCH: %zu distinct names, %u interned\n", seen.size(), pool->size());
+            exit(1);
+        }
+        printf("%7u   %10.1f   %9.1f   %19.1f\n", threads, cold, warm, locked);
+        delete pool;
+    }
+}
+
+static long max_rss_kb() {
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_maxrss;
+}
+
+// parse time and memory for one parse mode, run each mode in its own process
+// since the peak RSS can only go up
+static auto tree_capacity_bytes(const Ast& ast) -> size_t {
+    return ast.tags.capacity() + ast.main_tokens.capacity() * sizeof(TokenIndex) +
+           ast.datas.capacity() * sizeof(NodeData) + ast.extra_data.capacity() * 4;
+}
+
+static void bench_parse(string_view source, ParseMode mode) {
+    long rss_before = max_rss_kb();
+    size_t count_before = alloc_count;
+    size_t bytes_before = alloc_bytes;
+    auto start = Clock::now();
+
+    Parser parser(source, mode);
+    parser.parseRoot();
+    double ms = elapsed_ms(start);
+
+    size_t token_bytes = parser.tokens.kinds.capacity() + parser.tokens.starts.capacity() * 4 +
+                         parser.tokens.literal_tokens.capacity() * 4 +
+                         parser.tokens.literal_values.capacity() * 8 +
+                         (parser.stream ? sizeof(TokenRing) +
+                                              parser.stream->kept_tokens.capacity() * 4 +
+                                              parser.stream->kept_starts.capacity() * 4
+                                        : 0);
+    printf("mode            : %s\n", mode == Parse_Stream ? "stream" : "full");
+    printf("top level stmts : %zu\n", parser.ast.list(0).size());
+    printf("parse time      : %.2f ms\n", ms);
+    printf("token storage   : %zu bytes\n", token_bytes);
+    printf("allocations     : %zu\n", alloc_count - count_before);
+    printf("allocated bytes : %zu\n", alloc_bytes - bytes_before);
+    printf("tree            : %u nodes, %zu bytes used, %zu reserved\n", parser.ast.size(),
+           parser.ast.bytes(), tree_capacity_bytes(parser.ast));
+    printf("peak RSS        : %ld KB (%ld KB before parsing)\n", max_rss_kb(), rss_before);
+
+    start = Clock::now();
+    parser.ast = Ast();
+    printf("free tree       : %.3f ms\n", elapsed_ms(start));
+}
+
+// Hardware cache miss counter for this thread, -1 where perf events aren't allowed
+// (containers, perf_event_paranoid) and the numbers are reported as n/a.
+static int open_cache_miss_counter() {
+    perf_event_attr attr = {};
+    attr.type = PERF_TYPE_HARDWARE;
+    attr.size = sizeof(attr);
+    attr.config = PERF_COUNT_HW_CACHE_MISSES;
+    attr.disabled = 1;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    return (int)syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+}
+
+struct WalkResult {
+    double ms;
+    uint64_t cache_misses; // UINT64_MAX if unavailable
+    uint64_t checksum;
+};
+
+// best of `rounds`, cache misses of the same round
+template <typename F> static auto time_walk(int counter, int rounds, F walk) -> WalkResult {
+    WalkResult best = {1e30, UINT64_MAX, 0};
+    for (int round = 0; round < rounds; round++) {
+        if (counter >= 0) {
+            ioctl(counter, PERF_EVENT_IOC_RESET, 0);
+            ioctl(counter, PERF_EVENT_IOC_ENABLE, 0);
+        }
+        auto start = Clock::now();
+        uint64_t checksum = walk();
+        double ms = elapsed_ms(start);
+        uint64_t misses = UINT64_MAX;
+        if (counter >= 0) {
+            ioctl(counter, PERF_EVENT_IOC_DISABLE, 0);
+            if (read(counter, &misses, sizeof(misses)) != sizeof(misses)) misses = UINT64_MAX;
+        }
+        if (ms < best.ms) best = {ms, misses, checksum};
+    }
+    return best;
+}
+
+// Full depth-first walks of both representations, touching the same nodes in the same
+// order. Each visit adds the node's kind so the two checksums have to agree.
+struct ChecksumWalk : AstWalker<ChecksumWalk> {
+    uint64_t sum = 0;
+
+    auto pre(NodeIndex node) -> bool {
+        NodeKind tag = ast.tag(node);
+        sum += 1 + tag;
+        // the pointer tree has a node for the declared name
+        if (tag == Ast_VarDecl || tag == Ast_ConstDecl) sum += 1 + Ast_Identifier;
+        return true;
+    }
+};
+
+static auto walk_tree(const Node* node) -> uint64_t {
+    if (!node) return 0;
+    uint64_t sum = 1 + node->kind;
+    switch (node->kind) {
+    case Ast_Identifier:
+    case Ast_StringLiteral:
+    case Ast_NumberLiteral:
+    case Ast_FloatLiteral:
+    case Ast_Bool_Not:
+    case Ast_Negation:
+    case Ast_Bit_Not:
+    case Ast_AddressOf:
+    case Ast_Error:
+    case Ast_LazyBody:
+        break;
+    case Ast_Pointer:
+        sum += walk_tree(static_cast<const Pointer*>(node)->base);
+        break;
+    case Ast_Array: {
+        auto array = static_cast<const Array*>(node);
+        sum += walk_tree(array->len) + walk_tree(array->base);
+    } break;
+    case Ast_ParamDecl:
+        sum += walk_tree(static_cast<const ParamDecl*>(node)->type);
+        break;
+    case Ast_ParamDeclList:
+        for (auto param : static_cast<const ParamList*>(node)->params) sum += walk_tree(param);
+        break;
+    case Ast_Block:
+        for (auto stmt : static_cast<const Block*>(node)->stmts) sum += walk_tree(stmt);
+        break;
+    case Ast_Call:
+        for (auto arg : static_cast<const CallExpr*>(node)->params) sum += walk_tree(arg);
+        break;
+    case Ast_FnDecl: {
+        auto fn = static_cast<const FnDecl*>(node);
+        sum += walk_tree(fn->params) + walk_tree(fn->type) + walk_tree(fn->body);
+    } break;
+    case Ast_VarDecl: {
+        auto var = static_cast<const VarDecl*>(node);
+        sum += walk_tree(var->name) + walk_tree(var->type) + walk_tree(var->value_expr);
+    } break;
+    case Ast_ConstDecl: {
+        auto var = static_cast<const ConstDecl*>(node);
+        sum += walk_tree(var->name) + walk_tree(var->type) + walk_tree(var->value_expr);
+    } break;
+    case Ast_If_Simple: {
+        auto stmt = static_cast<const IfStmt*>(node);
+        sum += walk_tree(stmt->condition) + walk_tree(stmt->block);
+    } break;
+    case Ast_SimpleLoop: {
+        auto loop = static_cast<const LoopStmt*>(node);
+        sum += walk_tree(loop->expression) + walk_tree(loop->block);
+    } break;
+    default: {
+        auto expr = static_cast<const BinaryExpr*>(node);
+        sum += walk_tree(expr->lhs) + walk_tree(expr->rhs);
+    } break;
+    }
+    return sum;
+}
+
+static void print_walk(const char* name, WalkResult walk, uint32_t nodes) {
+    printf("%s: %.2f ms, %.2f ns/node, cache misses ", name, walk.ms, walk.ms * 1e6 / nodes);
+    if (walk.cache_misses == UINT64_MAX) {
+        printf("n/a\n");
+    } else {
+        printf("%lu (%.3f per node)\n", walk.cache_misses, (double)walk.cache_misses / nodes);
+    }
+}
+
+// flat index tree vs the pointer tree it can be turned into
+static void bench_ast(string_view source, int rounds) {
+    Parser parser(source);
+    auto start = Clock::now();
+    parser.parseRoot();
+    double parse_ms = elapsed_ms(start);
+    start = Clock::now();
+    vector<Stmt*> roots = parser.debug_tree();
+    double tree_ms = elapsed_ms(start);
+
+    const Ast& ast = parser.ast;
+    uint32_t nodes = ast.size();
+    printf("nodes           : %u (%.2f per token)\n", nodes, (double)nodes / parser.tokens.size());
+    printf("flat tree       : %zu bytes (%.1f per node), %zu of them extra_data\n", ast.bytes(),
+           (double)ast.bytes() / nodes, ast.extra_data.size() * 4);
+    printf("pointer tree    : %zu bytes (%.1f per node) in the arena\n", parser.arena.used(),
+           (double)parser.arena.used() / nodes);
+    printf("parse flat      : %.2f ms\n", parse_ms);
+    printf("flat -> pointer : %.2f ms\n", tree_ms);
+
+    int counter = open_cache_miss_counter();
+    WalkResult flat = time_walk(counter, rounds, [&] {
+        ChecksumWalk walk = {{ast}};
+        walk.walk(0);
+        return walk.sum;
+    });
+    WalkResult tree = time_walk(counter, rounds, [&] {
+        uint64_t sum = 1 + Ast_Root;
+        for (Stmt* stmt : roots) sum += walk_tree(stmt);
+        return sum;
+    });
+    if (counter >= 0) close(counter);
+    print_walk("walk flat       ", flat, nodes);
+    print_walk("walk pointer    ", tree, nodes);
+    printf("walks agree     : %s\n", flat.checksum == tree.checksum ? "yes" : "NO");
+}
+
+// signatures only (bodies skipped) vs a full parse, then the skipped bodies parsed after
+// all, which has to come out as the same tree
+static void bench_signatures(string_view source) {
+    auto start = Clock::now();
+    TokenList tokens = tokenize(source);
+    double lex_ms = elapsed_ms(start);
+
+    Parser full(source, TokenList(tokens));
+    start = Clock::now();
+    full.parseRoot();
+    double full_ms = elapsed_ms(start);
+
+    Parser lazy(source, TokenList(tokens));
+    lazy.lazy_bodies = true;
+    start = Clock::now();
+    lazy.parseRoot();
+    double lazy_ms = elapsed_ms(start);
+    uint32_t lazy_nodes = lazy.ast.size();
+
+    start = Clock::now();
+    lazy.parseBodies();
+    double bodies_ms = elapsed_ms(start);
+
+    ChecksumWalk expected = {{full.ast}};
+    expected.walk(0);
+    ChecksumWalk after = {{lazy.ast}};
+    after.walk(0);
+    printf("lex             : %8.2f ms\n", lex_ms);
+    printf("full parse      : %8.2f ms, %u nodes\n", full_ms, full.ast.size());
+    printf("signatures only : %8.2f ms, %u nodes (%.1fx)\n", lazy_ms, lazy_nodes,
+           full_ms / lazy_ms);
+    printf("bodies after    : %8.2f ms\n", bodies_ms);
+    printf("same tree       : %s\n", expected.sum == after.sum ? "yes" : "NO");
+}
+
+// Order dependent hash of a tree, two trees get the same one when they have the same
+// nodes at the same tokens in the same order, wherever the nodes are stored
+struct ShapeWalk : AstWalker<ShapeWalk> {
+    uint64_t hash = 0;
+
+    auto pre(NodeIndex node) -> bool {
+        uint64_t leaf = ast.tag(node) == Ast_LazyBody ? ast.data(node).lhs : 0;
+        uint64_t mix = (uint64_t)ast.tag(node) << 56 ^ (uint64_t)ast.main_token(node) << 20 ^ leaf;
+        hash = (hash ^ mix) * 0x9E3779B97F4A7C15;
+        return true;
+    }
+};
+
+static auto tree_shape(const Parser& parser) -> uint64_t {
+    ShapeWalk walk = {{parser.ast}};
+    walk.walk(0);
+    for (const Error& error : parser.errors)
+        walk.hash = (walk.hash ^ error.token) * 31 + error.kind;
+    return walk.hash;
+}
+
+// bytes [offset, end) of the word or number at `offset`
+static auto word_end(string_view text, uint32_t offset) -> uint32_t {
+    while (offset < text.size() && (isalnum((unsigned char)text[offset]) || text[offset] == '_'))
+        offset++;
+    return offset;
+}
+
+// Random edits like the ones made while typing, each relexed and reparsed and checked
+// against a parse of the whole file: identifiers and numbers changed, statements added
+// after a `;`, and now and then a broken edit (a stray brace, an operator) that the next
+// edit takes back.
+static void bench_reparse(string_view contents, int edits) {
+    static const char* names[] = {"a", "count", "x1", "value", "next_item"};
+    static const char* numbers[] = {"0", "7", "42", "1000"};
+    static const char* broken[] = {"{", "}", "+", "fn", ";", "(", "var"};
+    EditableSource source(contents);
+    Parser parser(source.view());
+    parser.parseRoot();
+    srand(4321);
+
+    double reparse_ms = 0, full_ms = 0;
+    uint64_t reparsed = 0;
+    int blocks = 0, top_level = 0, whole = 0;
+    SourceEdit undo = {0, 0, {}}; // takes the last broken edit back, if removed > 0
+    for (int i = 0; i < edits; i++) {
+        SourceEdit edit;
+        if (undo.removed) {
+            edit = undo;
+            undo = {0, 0, {}};
+        } else {
+            const TokenList& tokens = parser.tokens;
+            TokenIndex token = rand() % (tokens.size() - 1);
+            TokenKind kind = tokens.kind(token);
+            uint32_t offset = tokens.start(token);
+            edit = {offset, 0, {}};
+            if (rand() % 8 == 0) {
+                edit.inserted = broken[rand() % (sizeof(broken) / sizeof(broken[0]))];
+                undo = {offset, (uint32_t)edit.inserted.size(), {}};
+            } else if (kind == Tok_Identifier) {
+                edit.removed = word_end(source.view(), offset) - offset;
+                edit.inserted = names[rand() % (sizeof(names) / sizeof(names[0]))];
+            } else if (kind == Tok_NumberLiteral) {
+                edit.removed = word_end(source.view(), offset) - offset;
+                edit.inserted = numbers[rand() % (sizeof(numbers) / sizeof(numbers[0]))];
+            } else if (kind == Tok_Semicolon) {
+                edit.offset++;
+                edit.inserted = " x = 1;";
+            }
+        }
+        source.apply(edit);
+
+        auto start = Clock::now();
+        Reparsed result = parser.reparse(source.view(), edit);
+        reparse_ms += elapsed_ms(start);
+        reparsed += result.tokens;
+        if (result.kind == Ast_None) {
+            whole++;
+        } else if (result.kind == Ast_Root) {
+            top_level++;
+        } else {
+            blocks++;
+        }
+
+        start = Clock::now();
+        Parser expected(source.view());
+        expected.parseRoot();
+        full_ms += elapsed_ms(start);
+
+        if (tree_shape(parser) != tree_shape(expected) ||
+            parser.root_starts != expected.root_starts) {
+            printf("MISMATCH after edit %d (offset %u, removed %u, inserted `" SV_FMT "`)\n", i,
+                   edit.offset, edit.removed, SV_ARG(edit.inserted));
+            exit(1);
+        }
+    }
+    printf("edits           : %d on %u tokens, all identical to a full parse\n", edits,
+           parser.tokens.size());
+    printf("reparsed        : %d blocks, %d top level, %d whole files\n", blocks, top_level,
+           whole);
+    printf("reparsed tokens : %.1f per edit\n", (double)reparsed / edits);
+    printf("incremental     : %.3f ms per edit (relex and reparse)\n", reparse_ms / edits);
+    printf("full            : %.3f ms per edit (tokenize and parse)\n", full_ms / edits);
+}
+
+// What a cache run in a child process measured, in memory shared with the parent
+struct CacheRun {
+    double parse_ms; // lex and parse
+    double store_ms;
+    double load_ms;
+    bool hit;
+    uint64_t checksum;
+};
+
+// runs `f(run)` in a fresh process, a cache hit needs an interner that hasn't seen the
+// names yet and this one has
+static auto in_child(auto&& f) -> CacheRun {
+    auto run = (CacheRun*)mmap(nullptr, sizeof(CacheRun), PROT_READ | PROT_WRITE,
+                               MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    *run = {};
+    pid_t pid = fork();
+    if (pid == 0) {
+        f(run);
+        _exit(0);
+    }
+    waitpid(pid, nullptr, 0);
+    CacheRun result = *run;
+    munmap(run, sizeof(CacheRun));
+    return result;
+}
+
+// cold start (lex, parse, store) vs warm start (load) of the frontend, best of `rounds`
+static void bench_cache(string_view source, const char* dir, int rounds) {
+    AstCache cache;
+    cache.dir = dir;
+    auto checksum = [](const Ast& ast) {
+        ChecksumWalk walk = {{ast}};
+        walk.walk(0);
+        return walk.sum;
+    };
+    CacheRun cold = {1e30, 1e30, 0, false, 0}, warm = {0, 0, 1e30, true, 0};
+    for (int round = 0; round < rounds; round++) {
+        CacheRun run = in_child([&](CacheRun* run) {
+            auto start = Clock::now();
+            Parser parser(source);
+            parser.parseRoot();
+            run->parse_ms = elapsed_ms(start);
+            start = Clock::now();
+            cache.store(source, parser.tokens, parser.comments, parser.ast);
+            run->store_ms = elapsed_ms(start);
+            run->checksum = checksum(parser.ast);
+        });
+        cold = {std::min(cold.parse_ms, run.parse_ms), std::min(cold.store_ms, run.store_ms), 0,
+                false, run.checksum};
+        run = in_child([&](CacheRun* run) {
+            auto start = Clock::now();
+            TokenList tokens;
+            CommentTable comments;
+            Ast ast;
+            run->hit = cache.load(source, &tokens, &comments, &ast);
+            run->load_ms = elapsed_ms(start);
+            run->checksum = checksum(ast);
+        });
+        warm = {0, 0, std::min(warm.load_ms, run.load_ms), warm.hit && run.hit, run.checksum};
+    }
+    printf("cold: lex+parse : %8.2f ms\n", cold.parse_ms);
+    printf("cold: store     : %8.2f ms\n", cold.store_ms);
+    printf("warm: load      : %8.2f ms (%.1fx faster than lex+parse)\n", warm.load_ms,
+           cold.parse_ms / warm.load_ms);
+    printf("hit             : %s\n", warm.hit ? "yes" : "NO");
+    printf("same tree       : %s\n", warm.hit && warm.checksum == cold.checksum ? "yes" : "NO");
+}
+
+// points stdout at `fd` until restore_stdout(), returns the old stdout to pass to it
+static int redirect_stdout(int fd) {
+    fflush(stdout);
+    int saved = dup(1);
+    dup2(fd, 1);
+    return saved;
+}
+static void restore_stdout(int saved) {
+    fflush(stdout);
+    dup2(saved, 1);
+    close(saved);
+}
+
+static auto read_back(FILE* file) -> string {
+    fflush(file);
+    string text(ftell(file), '\0');
+    rewind(file);
+    if (fread(text.data(), 1, text.size(), file) != text.size()) text.clear();
+    return text;
+}
+
+// printing through the AstWalker vs the virtual print() of the pointer tree
+static void bench_print(string_view source, int rounds) {
+    Parser parser(source);
+    parser.parseRoot();
+    vector<Stmt*> roots = parser.debug_tree();
+    auto print_virtual = [&] {
+        for (Stmt* stmt : roots) stmt->print();
+    };
+
+    // both write the same text, checked once into files and then timed into /dev/null
+    FILE* virtual_out = tmpfile();
+    FILE* walker_out = tmpfile();
+    int saved = redirect_stdout(fileno(virtual_out));
+    print_virtual();
+    restore_stdout(saved);
+    saved = redirect_stdout(fileno(walker_out));
+    parser.print_tree();
+    restore_stdout(saved);
+    string expected = read_back(virtual_out);
+    bool same = expected == read_back(walker_out);
+    fclose(virtual_out);
+    fclose(walker_out);
+
+    int null = open("/dev/null", O_WRONLY);
+    double virtual_ms = 1e30, walker_ms = 1e30;
+    for (int round = 0; round < rounds; round++) {
+        saved = redirect_stdout(null);
+        auto start = Clock::now();
+        print_virtual();
+        fflush(stdout);
+        virtual_ms = std::min(virtual_ms, elapsed_ms(start));
+        start = Clock::now();
+        parser.print_tree();
+        fflush(stdout);
+        walker_ms = std::min(walker_ms, elapsed_ms(start));
+        restore_stdout(saved);
+    }
+
+    // the machine readable forms, also written out in full
+    struct {
+        const char* name;
+        EmitFormat format;
+        double ms = 1e30;
+        size_t bytes = 0;
+    } formats[] = {{"json            ", Emit_Json}, {"sexpr           ", Emit_Sexpr}};
+    for (auto& f : formats) {
+        for (int round = 0; round < rounds; round++) {
+            OutBuffer out(null);
+            auto start = Clock::now();
+            parser.emit_ast(out, f.format);
+            out.flush();
+            f.ms = std::min(f.ms, elapsed_ms(start));
+        }
+        OutBuffer text;
+        parser.emit_ast(text, f.format);
+        f.bytes = text.bytes.size();
+    }
+    close(null);
+
+    uint32_t nodes = parser.ast.size();
+    printf("nodes           : %u, %zu bytes printed\n", nodes, expected.size());
+    printf("virtual print   : %.2f ms, %.2f ns/node\n", virtual_ms, virtual_ms * 1e6 / nodes);
+    printf("walker print    : %.2f ms, %.2f ns/node\n", walker_ms, walker_ms * 1e6 / nodes);
+    for (auto& f : formats) {
+        printf("%s: %.2f ms, %.2f ns/node, %zu bytes\n", f.name, f.ms, f.ms * 1e6 / nodes,
+               f.bytes);
+    }
+    printf("same output     : %s\n", same ? "yes" : "NO");
+}
+
+// Formatting time, and checking time on both an unformatted and a formatted file. The
+// formatted text has to lex to the same tokens and comments and come out of a second
+// formatting the same, and formatting must not have added to the shared pools.
+static void bench_format(string_view source, int rounds) {
+    Formatter formatter;
+    uint32_t names = identifier_pool.size(), strings = string_pool.size();
+    if (formatter.format(source) == Format_Error) {
+        printf("syntax error at %s, not formatted\n", formatter.error.c_str());
+        return;
+    }
+    EditableSource formatted(formatter.out.bytes);
+    formatter.format(formatted.view(), true);
+    bool pools_untouched = identifier_pool.size() == names && string_pool.size() == strings;
+
+    struct Lexed {
+        TokenList tokens;
+        CommentTable comments = {Comments_All, {}};
+    };
+    auto lex = [](string_view text) {
+        Lexed lexed;
+        lexed.tokens = tokenize(text, &lexed.comments);
+        return lexed;
+    };
+    Lexed before = lex(source), after = lex(formatted.view());
+    auto comment_text = [](string_view text, const Comment& c) {
+        string_view s = text.substr(c.start, c.len);
+        while (!s.empty() && (s.back() == ' ' || s.back() == '\t' || s.back() == '\r'))
+            s.remove_suffix(1);
+        return s;
+    };
+    bool same_tokens = before.tokens.kinds == after.tokens.kinds &&
+                       before.tokens.literal_values == after.tokens.literal_values &&
+                       before.comments.comments.size() == after.comments.comments.size();
+    for (uint32_t i = 0; same_tokens && i < before.comments.comments.size(); i++) {
+        same_tokens = comment_text(source, before.comments.comments[i]) ==
+                      comment_text(formatted.view(), after.comments.comments[i]);
+    }
+    bool stable = formatter.format(formatted.view()) == Format_Same;
+
+    double parse_ms = 1e30, format_ms = 1e30, check_changed_ms = 1e30, check_same_ms = 1e30;
+    for (int round = 0; round < rounds; round++) {
+        auto start = Clock::now();
+        Parser parser(source);
+        parser.parseRoot();
+        parse_ms = std::min(parse_ms, elapsed_ms(start));
+        start = Clock::now();
+        formatter.format(source);
+        format_ms = std::min(format_ms, elapsed_ms(start));
+        start = Clock::now();
+        formatter.format(source, true);
+        check_changed_ms = std::min(check_changed_ms, elapsed_ms(start));
+        start = Clock::now();
+        formatter.format(formatted.view(), true);
+        check_same_ms = std::min(check_same_ms, elapsed_ms(start));
+    }
+
+    double mb = source.size() / 1e6;
+    uint32_t tokens = before.tokens.size();
+    printf("tokens          : %u, %u comments, %zu -> %u bytes\n", tokens,
+           (uint32_t)before.comments.comments.size(), source.size(), formatted.size());
+    printf("lex + parse     : %.2f ms, %.1f MB/s\n", parse_ms, mb / parse_ms * 1e3);
+    printf("format          : %.2f ms, %.1f MB/s, %.2f ns/token\n", format_ms,
+           mb / format_ms * 1e3, format_ms * 1e6 / tokens);
+    printf("check, formatted: %.2f ms, %.1f MB/s\n", check_same_ms, mb / check_same_ms * 1e3);
+    printf("check, not      : %.2f ms (stops at the first line that differs)\n",
+           check_changed_ms);
+    printf("same tokens     : %s\n", same_tokens ? "yes" : "NO");
+    printf("stable          : %s\n", stable ? "yes" : "NO");
+    printf("pools untouched : %s\n", pools_untouched ? "yes" : "NO");
+}
+
+// parse time of machine generated input nested `count` deep, at 1/8, 1/4, 1/2 and all of
+// `count` to show it stays linear
+static void bench_deep_shape(const char* name, long count, auto&& write) {
+    for (long n = count / 8; n <= count; n *= 2) {
+        string source;
+        write(source, n);
+        Parser parser(source);
+        auto start = Clock::now();
+        parser.parseRoot();
+        double ms = elapsed_ms(start);
+        printf("%-7s %9ld deep: %8.2f ms  %6.1f ns per level  %u nodes\n", name, n, ms,
+               ms * 1e6 / n, parser.ast.size());
+    }
+}
+
+static void bench_deep(long terms, long blocks) {
+    static const char* ops[] = {" + ", " * ", " - ", " < ", " / ", " && "};
+    bench_deep_shape("expr", terms, [](string& s, long n) {
+        s += "x = a";
+        for (long i = 1; i < n; i++) {
+            s += ops[i % 6];
+            s += i % 3 ? "b" : "12";
+        }
+        s += ";\n";
+    });
+    bench_deep_shape("field", terms, [](string& s, long n) {
+        s += "x = a";
+        for (long i = 1; i < n; i++) s += ".b";
+        s += ";\n";
+    });
+    bench_deep_shape("type", terms, [](string& s, long n) {
+        s += "var p: ";
+        for (long i = 0; i < n; i++) s += i % 2 ? "*" : "[4]";
+        s += "int = 0;\n";
+    });
+    bench_deep_shape("blocks", blocks, [](string& s, long n) {
+        s += "fn f() -> int {\n";
+        for (long i = 0; i < n; i++) s += i % 2 ? "for a < b {\n" : "if a {\n";
+        for (long i = 0; i < n; i++) s += "x = 1;\n}\n";
+        s += "}\n";
+    });
+}
+
+static void usage(const char* prog) {
+    fprintf(stdout, "Usage: \n");
+    fprintf(stdout, "\t%s gen <FUNCTION_COUNT> [comments]  write a generated .drg file to stdout\n",
+            prog);
+    fprintf(stdout, "\t%s tokens <FILE_NAME>       allocations and time per token\n", prog);
+    fprintf(stdout, "\t%s scan <FILE_NAME>         lexer MB/s for each scan kernel path\n", prog);
+    fprintf(stdout, "\t%s parse <FILE_NAME> [stream]  parse time, allocations and peak RSS\n",
+            prog);
+    fprintf(stdout, "\t%s signatures <FILE_NAME>    lazy function bodies vs a full parse\n", prog);
+    fprintf(stdout, "\t%s cache <FILE_NAME> <DIR> [ROUNDS]  cold vs warm start with the AST cache\n",
+            prog);
+    fprintf(stdout, "\t%s ast <FILE_NAME> [ROUNDS]   flat vs pointer tree size and walk time\n",
+            prog);
+    fprintf(stdout, "\t%s print <FILE_NAME> [ROUNDS] tree printing, AstWalker vs virtual, json, sexpr\n",
+            prog);
+    fprintf(stdout, "\t%s format <FILE_NAME> [ROUNDS] drgfmt formatting and --check time\n",
+            prog);
+    fprintf(stdout, "\t%s lex-parallel <FILE_NAME> <JOBS>  chunked vs sequential lexing\n", prog);
+    fprintf(stdout, "\t%s parse-parallel <FILE_NAME> <JOBS>  parseRootParallel vs parseRoot\n",
+            prog);
+    fprintf(stdout, "\t%s relex <FILE_NAME> <EDITS>  incremental vs full relexing\n", prog);
+    fprintf(stdout, "\t%s reparse <FILE_NAME> <EDITS>  incremental vs full reparsing\n", prog);
+    fprintf(stdout, "\t%s utf8 <FILE_NAME> [FUZZ]  UTF-8 validation MB/s for each path\n", prog);
+    fprintf(stdout, "\t%s strings <FILE_NAME>       string literal decoding and pooling\n", prog);
+    fprintf(stdout, "\t%s intern <FILE_NAME> <THREADS>  identifier interning vs thread count\n",
+            prog);
+    fprintf(stdout, "\t%s deep <TERMS> [BLOCKS]     parse time of deeply nested input\n",
+            prog);
+    fprintf(stdout, "\t%s numbers <COUNT>          number literal decoding vs libc\n", prog);
+}
+
+int main(int argc, char** argv) {
+    if (argc < 3) {
+        usage(argv[0]);
+        exit(0);
+    }
+
+    if (strcmp(argv[1], "gen") == 0) {
+        gen_source(atol(argv[2]), argc > 3 && strcmp(argv[3], "comments") == 0);
+        return 0;
+    }
+    if (strcmp(argv[1], "deep") == 0) {
+        bench_deep(atol(argv[2]), argc > 3 ? atol(argv[3]) : atol(argv[2]) / 10);
+        return 0;
+    }
+    if (strcmp(argv[1], "numbers") == 0) {
+        bench_numbers(atol(argv[2]));
+        return 0;
+    }
+
+    auto source = read_file(argv[2]);
+    if (strcmp(argv[1], "tokens") == 0) {
+        bench_tokens(source);
+    } else if (strcmp(argv[1], "scan") == 0) {
+        bench_scan(source);
+    } else if (strcmp(argv[1], "strings") == 0) {
+        bench_strings(source);
+    } else if (strcmp(argv[1], "utf8") == 0) {
+        bench_utf8(source, argc > 3 ? atoi(argv[3]) : 100000);
+    } else if (strcmp(argv[1], "lex-parallel") == 0 && argc > 3) {
+        bench_lex_parallel(source, atoi(argv[3]));
+    } else if (strcmp(argv[1], "parse-parallel") == 0 && argc > 3) {
+        bench_parse_parallel(source, atoi(argv[3]));
+    } else if (strcmp(argv[1], "intern") == 0 && argc > 3) {
+        bench_intern(source, atoi(argv[3]));
+    } else if (strcmp(argv[1], "relex") == 0 && argc > 3) {
+        bench_relex(source, atoi(argv[3]));
+    } else if (strcmp(argv[1], "reparse") == 0 && argc > 3) {
+        bench_reparse(source, atoi(argv[3]));
+    } else if (strcmp(argv[1], "cache") == 0 && argc > 3) {
+        bench_cache(source, argv[3], argc > 4 ? atoi(argv[4]) : 3);
+    } else if (strcmp(argv[1], "signatures") == 0) {
+        bench_signatures(source);
+    } else if (strcmp(argv[1], "ast") == 0) {
+        bench_ast(source, argc > 3 ? atoi(argv[3]) : 5);
+    } else if (strcmp(argv[1], "print") == 0) {
+        bench_print(source, argc > 3 ? atoi(argv[3]) : 3);
+    } else if (strcmp(argv[1], "format") == 0) {
+        bench_format(source, argc > 3 ? atoi(argv[3]) : 3);
+    } else if (strcmp(argv[1], "parse") == 0) {
+        bool stream = argc > 3 && strcmp(argv[3], "stream") == 0;
+        bench_parse(source, stream ? Parse_Stream : Parse_Full);
+    } else {
+        usage(argv[0]);
+    }
+}
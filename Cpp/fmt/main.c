@@ -0,0 +1,159 @@
+#include "../src/format.h"
+#include "../src/parallel.h"
+#include "../src/source.h"
+#include <algorithm>
+#include <dirent.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <thread>
+#include <unistd.h>
+using namespace std;
+
+static void usage(const char* prog) {
+    fprintf(stdout, "Usage: \n");
+    fprintf(stdout, "\t%s [OPTIONS] <FILE|DIR>...\n", prog);
+    fprintf(stdout, "Formats .drg files in place, directories are searched for them.\n");
+    fprintf(stdout, "Options: \n");
+    fprintf(stdout, "\t--check         write nothing, list the files that aren't formatted and exit\n");
+    fprintf(stdout, "\t                with 1 if there are any\n");
+    fprintf(stdout, "\t--stdout        print the formatted files instead of rewriting them\n");
+    fprintf(stdout, "\t--jobs <N>      format on N threads, all cores by default\n");
+    fprintf(stdout, "Exit status: \n");
+    fprintf(stdout, "\t0 done, 1 if --check found files that aren't formatted, 2 if a file\n");
+    fprintf(stdout, "\tor directory couldn't be read or written, or a file has bytes that\n");
+    fprintf(stdout, "\taren't tokens or syntax errors (it's left alone, the rest are still\n");
+    fprintf(stdout, "\tformatted or checked). --check stops reading a file at its first line\n");
+    fprintf(stdout, "\tthat isn't formatted, syntax errors after it aren't reported.\n");
+}
+
+// .drg files under `dir`, hidden directories (.git) are left out. False if a directory
+// couldn't be read.
+static auto find_sources(const string& dir, vector<string>* files) -> bool {
+    DIR* d = opendir(dir.c_str());
+    if (!d) {
+        fprintf(stderr, "%s: couldn't open directory\n", dir.c_str());
+        return false;
+    }
+    bool ok = true;
+    while (dirent* entry = readdir(d)) {
+        const char* name = entry->d_name;
+        if (name[0] == '.') continue;
+        string path = dir + "/" + name;
+        unsigned char type = entry->d_type;
+        if (type == DT_UNKNOWN || type == DT_LNK) {
+            struct stat st;
+            if (stat(path.c_str(), &st) != 0) continue;
+            type = S_ISDIR(st.st_mode) ? DT_DIR : S_ISREG(st.st_mode) ? DT_REG : DT_UNKNOWN;
+        }
+        size_t len = strlen(name);
+        if (type == DT_DIR) {
+            ok = find_sources(path, files) && ok;
+        } else if (type == DT_REG && len > 4 && strcmp(name + len - 4, ".drg") == 0) {
+            files->push_back(static_cast<string&&>(path));
+        }
+    }
+    closedir(d);
+    return ok;
+}
+
+// Written to a temporary file next to it and renamed over it, so a run that is stopped
+// halfway leaves every file old or new, never cut short
+static auto replace_file(const string& path, OutBuffer& out) -> bool {
+    struct stat st;
+    if (stat(path.c_str(), &st) != 0) return false;
+    string temp = path + ".fmt" + to_string(getpid());
+    int fd = open(temp.c_str(), O_WRONLY | O_CREAT | O_TRUNC, st.st_mode & 07777);
+    if (fd < 0) return false;
+    out.fd = fd;
+    bool written = out.flush();
+    out.fd = -1;
+    written = close(fd) == 0 && written;
+    if (!written || rename(temp.c_str(), path.c_str()) != 0) {
+        unlink(temp.c_str());
+        return false;
+    }
+    return true;
+}
+
+struct FileResult {
+    FormatResult result = Format_Same;
+    string error;
+};
+
+int main(int argc, char** argv) {
+    bool check = false;
+    bool to_stdout = false;
+    uint32_t jobs = std::max(1u, thread::hardware_concurrency());
+    vector<string> files;
+    int status = 0;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--check") == 0) {
+            check = true;
+        } else if (strcmp(argv[i], "--stdout") == 0) {
+            to_stdout = true;
+        } else if (strcmp(argv[i], "--jobs") == 0 && i + 1 < argc) {
+            jobs = std::max(1, atoi(argv[++i]));
+        } else if (argv[i][0] == '-' && argv[i][1] != '\0') {
+            usage(argv[0]);
+            exit(0);
+        } else {
+            string path = argv[i];
+            struct stat st;
+            if (stat(path.c_str(), &st) == 0 && S_ISDIR(st.st_mode)) {
+                while (path.size() > 1 && path.back() == '/') path.pop_back();
+                size_t first = files.size();
+                if (!find_sources(path, &files)) status = 2;
+                std::sort(files.begin() + first, files.end());
+            } else {
+                files.push_back(path);
+            }
+        }
+    }
+    if (files.empty()) {
+        usage(argv[0]);
+        exit(0);
+    }
+    // in file order
+    if (to_stdout) jobs = 1;
+
+    vector<FileResult> results(files.size());
+    for_each_parallel(jobs, files.size(), [&](uint32_t i) {
+        // one per thread, its buffers are reused for every file the thread gets
+        static thread_local Formatter formatter;
+        FileResult& result = results[i];
+        string error;
+        SourceBuffer source = read_file(files[i].c_str(), &error);
+        if (!error.empty()) {
+            result.result = Format_Error;
+            result.error = static_cast<string&&>(error);
+            return;
+        }
+        result.result = formatter.format(source, check && !to_stdout);
+        if (result.result == Format_Error) {
+            result.error = files[i] + ":" + formatter.error;
+        } else if (to_stdout) {
+            formatter.out.fd = STDOUT_FILENO;
+            formatter.out.flush();
+            formatter.out.fd = -1;
+        } else if (result.result == Format_Changed && !check &&
+                   !replace_file(files[i], formatter.out)) {
+            result.result = Format_Error;
+            result.error = files[i] + ": couldn't write the formatted file";
+        }
+    });
+
+    for (uint32_t i = 0; i < files.size(); i++) {
+        const FileResult& result = results[i];
+        if (result.result == Format_Error) {
+            fprintf(stderr, "%s\n", result.error.c_str());
+            status = 2;
+        } else if (result.result == Format_Changed && check && !to_stdout) {
+            fprintf(stdout, "%s\n", files[i].c_str());
+            if (status == 0) status = 1;
+        }
+    }
+    return status;
+}
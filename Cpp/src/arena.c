@@ -0,0 +1,48 @@
+#include "arena.h"
+#include <algorithm>
+#include <stdio.h>
+#include <stdlib.h>
+
+Arena& Arena::operator=(Arena&& other) {
+    if (this == &other) return *this;
+    release();
+    chunk = other.chunk;
+    chunk_start = other.chunk_start;
+    cursor = other.cursor;
+    limit = other.limit;
+    used_before = other.used_before;
+    reserved_bytes = other.reserved_bytes;
+    other.chunk = nullptr;
+    other.release();
+    return *this;
+}
+
+// one free() per chunk, however many nodes were allocated
+void Arena::release() {
+    while (chunk) {
+        Chunk* prev = chunk->prev;
+        free(chunk);
+        chunk = prev;
+    }
+    chunk_start = cursor = limit = 0;
+    used_before = reserved_bytes = 0;
+}
+
+// chunks double up to max_chunk, anything bigger than that gets a chunk of its own size
+auto Arena::alloc_slow(size_t size, size_t align) -> void* {
+    used_before += cursor - chunk_start;
+    size_t chunk_size = chunk ? std::min(chunk->size * 2, max_chunk) : first_chunk;
+    chunk_size = std::max(chunk_size, sizeof(Chunk) + size + align);
+    Chunk* next = (Chunk*)malloc(chunk_size);
+    if (!next) {
+        fprintf(stderr, "out of memory allocating a %zu byte arena chunk\n", chunk_size);
+        exit(1);
+    }
+    next->prev = chunk;
+    next->size = chunk_size;
+    chunk = next;
+    reserved_bytes += chunk_size;
+    chunk_start = cursor = (uintptr_t)(next + 1);
+    limit = (uintptr_t)next + chunk_size;
+    return alloc(size, align);
+}
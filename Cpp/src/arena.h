@@ -0,0 +1,76 @@
+#pragma once
+#include <new>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include <type_traits>
+#include <utility>
+
+// Bump allocator for everything that lives as long as one parsed file (the tree nodes
+// and their child lists). Allocating is a pointer bump, nothing is freed on its own and
+// the destructor hands the chunks back in one go, so no destructor ever runs for what's
+// in here: only trivially destructible types are allowed.
+struct Arena {
+    Arena() {}
+    Arena(const Arena&) = delete;
+    Arena& operator=(const Arena&) = delete;
+    Arena(Arena&& other) { *this = std::move(other); }
+    Arena& operator=(Arena&& other);
+    ~Arena() { release(); }
+
+    auto alloc(size_t size, size_t align) -> void* {
+        uintptr_t p = (cursor + align - 1) & ~(uintptr_t)(align - 1);
+        if (p + size > limit) return alloc_slow(size, align);
+        cursor = p + size;
+        return (void*)p;
+    }
+
+    template <typename T, typename... Args> auto make(Args&&... args) -> T* {
+        static_assert(std::is_trivially_destructible_v<T>, "the arena never runs destructors");
+        return new (alloc(sizeof(T), alignof(T))) T(std::forward<Args>(args)...);
+    }
+
+    template <typename T> auto alloc_array(size_t count) -> T* {
+        static_assert(std::is_trivially_destructible_v<T>, "the arena never runs destructors");
+        return (T*)alloc(sizeof(T) * count, alignof(T));
+    }
+
+    // frees every chunk, everything allocated so far is gone
+    void release();
+
+    // bytes handed out / bytes held in chunks
+    auto used() const -> size_t { return used_before + (cursor - chunk_start); }
+    auto reserved() const -> size_t { return reserved_bytes; }
+
+  private:
+    static constexpr size_t first_chunk = 64 * 1024;
+    static constexpr size_t max_chunk = 16 * 1024 * 1024;
+
+    // chunks are a linked list through their first bytes
+    struct Chunk {
+        Chunk* prev;
+        size_t size;
+    };
+
+    Chunk* chunk = nullptr;
+    uintptr_t chunk_start = 0;
+    uintptr_t cursor = 0;
+    uintptr_t limit = 0;
+    size_t used_before = 0; // by the chunks before this one
+    size_t reserved_bytes = 0;
+
+    auto alloc_slow(size_t size, size_t align) -> void*;
+};
+
+// Child list of a tree node, the items live in the same arena as the node. Built from
+// the parser's scratch stack once the number of children is known.
+template <typename T> struct NodeList {
+    T* items = nullptr;
+    uint32_t count = 0;
+
+    auto size() const -> uint32_t { return count; }
+    auto empty() const -> bool { return count == 0; }
+    auto begin() const -> T* { return items; }
+    auto end() const -> T* { return items + count; }
+    auto operator[](uint32_t i) const -> T& { return items[i]; }
+};
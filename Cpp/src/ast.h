@@ -0,0 +1,203 @@
+#pragma once
+#include "intern.h"
+#include "lexer.h"
+#include <stdint.h>
+#include <span>
+#include <string.h>
+#include <type_traits>
+#include <vector>
+
+enum NodeKind {
+    Ast_None,
+    Ast_Root,
+    Ast_Identifier,
+    Ast_StringLiteral,
+    Ast_NumberLiteral,
+    Ast_FloatLiteral,
+    Ast_NullLiteral,
+    Ast_IncludeStmt,
+    Ast_MacroDefine,
+    Ast_Mul,
+    Ast_Add,
+    Ast_Sub,
+    Ast_Div,
+    Ast_Bool_Not,
+    Ast_Bool_Or,
+    Ast_Bool_And,
+    Ast_Bit_Not,
+    Ast_Bit_Xor,
+    Ast_Bit_And,
+    Ast_Bit_Or,
+    Ast_ShiftLeft,
+    Ast_ShiftRight,
+    Ast_AddressOf,
+    Ast_Slice,
+    Ast_SliceSentinel,
+    Ast_SliceOpen,
+    Ast_Assign,
+    Ast_ArrayAccess,
+    Ast_FieldAccess,
+    Ast_Negation,
+    Ast_FnProto,
+    Ast_FnDecl,
+    Ast_VarDecl,
+    Ast_ConstDecl,
+    Ast_Deref,
+    Ast_Macro,
+    Ast_ParamDecl,
+    Ast_ParamDeclList,
+    Ast_Block,
+    Ast_If_Simple,
+    Ast_If,
+    Ast_WhileLoop,
+    Ast_ForLoop,
+    Ast_SimpleLoop,
+    Ast_Struct,
+    Ast_Union,
+    Ast_TypeName,
+    Ast_DeclType,
+    Ast_Array,
+    Ast_Pointer,
+    Ast_Label,
+    Ast_LessThan,
+    Ast_GreaterThan,
+    Ast_EqualEqual,
+    Ast_NotEqual,
+    Ast_CallOne,
+    Ast_Call,
+    Ast_Error,    // what couldn't be parsed, main_token is where the error was found
+    Ast_LazyBody, // a function body that wasn't parsed yet, see Parser::parseBody()
+};
+
+auto enum_to_str(NodeKind kind) -> const char*;
+
+// The syntax tree the parser builds, flat like the token list: one entry per node in
+// each of `tags`, `main_tokens` and `datas` (13 bytes a node), children referred to by
+// 32 bit index, and anything that doesn't fit in two words in `extra_data`. Nodes are
+// mostly appended in the order they are finished, children before their parent. The
+// exceptions are `*` and `[n]` type prefixes, which come before the type they apply to,
+// and the root, which is reserved first at index 0. That makes 0 free to mean "no node"
+// in a child slot. Function bodies parsed later by Parser::parseBody() go after all of it,
+// and so do the blocks and statements Parser::reparse() parses again after an edit. What
+// they replace stays where it was, unreferenced, until the next full parse.
+//
+// What `main_token` and `lhs`/`rhs` hold for each tag:
+//
+//   Root                    lhs..rhs = top level statements, a range of extra_data
+//   Identifier              lhs = SymbolId, also for identifier types
+//   NumberLiteral,
+//   FloatLiteral            lhs, rhs = low, high half of the value (float bits)
+//   StringLiteral           lhs = StringId
+//   Bool_Not, Negation,
+//   Bit_Not, AddressOf      main_token is the operand, no children
+//   binary ops, Assign,
+//   FieldAccess             main_token = operator, lhs, rhs = operands (either can be 0)
+//   Pointer                 main_token = `*`, lhs = base type
+//   Array                   main_token = `[`, lhs = length expr or 0, rhs = base type
+//   ParamDecl               main_token = name, lhs = type, rhs = SymbolId
+//   ParamDeclList, Block    lhs..rhs = children, a range of extra_data
+//   Call                    main_token = name, lhs = SymbolId, rhs = extra SubRange of args
+//   FnDecl                  main_token = name, lhs = extra FnProto, rhs = body
+//   VarDecl, ConstDecl      main_token = name, lhs = extra VarDeclInfo
+//   If_Simple               main_token = `if`, lhs = condition, rhs = block
+//   SimpleLoop              main_token = `for`, lhs = expr, rhs = block
+//   Error                   main_token = where the syntax error is, no children
+//   LazyBody                main_token = `{`, lhs = tokens from there to the matching `}`
+//
+// A 0 in a list means the statement there didn't parse to anything.
+
+using NodeIndex = uint32_t;
+
+struct NodeData {
+    uint32_t lhs;
+    uint32_t rhs;
+};
+
+// [start, end) of extra_data
+struct SubRange {
+    uint32_t start;
+    uint32_t end;
+};
+
+struct FnProto {
+    SymbolId name;
+    NodeIndex params;
+    NodeIndex return_type;
+};
+
+struct VarDeclInfo {
+    SymbolId name;
+    NodeIndex type;  // 0 if inferred
+    NodeIndex value; // 0 if there is no initializer
+};
+
+struct Ast {
+    vector<uint8_t> tags; // NodeKind
+    vector<TokenIndex> main_tokens;
+    vector<NodeData> datas;
+    vector<uint32_t> extra_data;
+
+    auto tag(NodeIndex i) const -> NodeKind { return (NodeKind)tags[i]; }
+    auto main_token(NodeIndex i) const -> TokenIndex { return main_tokens[i]; }
+    auto data(NodeIndex i) const -> NodeData { return datas[i]; }
+    auto size() const -> uint32_t { return (uint32_t)tags.size(); }
+
+    auto add_node(NodeKind tag, TokenIndex main_token, NodeData data) -> NodeIndex {
+        tags.push_back((uint8_t)tag);
+        main_tokens.push_back(main_token);
+        datas.push_back(data);
+        return (NodeIndex)tags.size() - 1;
+    }
+
+    // the extra structs are plain runs of u32 in extra_data
+    template <typename T> auto add_extra(const T& extra) -> uint32_t {
+        static_assert(sizeof(T) % 4 == 0 && std::is_trivially_copyable_v<T>);
+        uint32_t at = (uint32_t)extra_data.size();
+        extra_data.resize(at + sizeof(T) / 4);
+        memcpy(&extra_data[at], &extra, sizeof(T));
+        return at;
+    }
+    template <typename T> auto extra(uint32_t at) const -> T {
+        T result;
+        memcpy(&result, &extra_data[at], sizeof(T));
+        return result;
+    }
+
+    auto add_list(const NodeIndex* items, uint32_t count) -> SubRange {
+        uint32_t start = (uint32_t)extra_data.size();
+        extra_data.insert(extra_data.end(), items, items + count);
+        return {start, (uint32_t)extra_data.size()};
+    }
+    auto list(SubRange range) const -> std::span<const NodeIndex> {
+        return {extra_data.data() + range.start, range.end - range.start};
+    }
+    // the children of a Root, Block or ParamDeclList
+    auto list(NodeIndex i) const -> std::span<const NodeIndex> {
+        return list(SubRange{datas[i].lhs, datas[i].rhs});
+    }
+
+    // the 64 bit value of a number or float literal
+    auto literal_value(NodeIndex i) const -> uint64_t {
+        return datas[i].lhs | (uint64_t)datas[i].rhs << 32;
+    }
+
+    // sized from the token count, real code makes about 0.7 nodes and 0.3 extra words
+    // per token
+    void reserve(uint32_t token_count) {
+        tags.reserve(token_count / 4 * 3);
+        main_tokens.reserve(token_count / 4 * 3);
+        datas.reserve(token_count / 4 * 3);
+        extra_data.reserve(token_count / 3);
+    }
+    void clear() {
+        tags.clear();
+        main_tokens.clear();
+        datas.clear();
+        extra_data.clear();
+    }
+
+    auto bytes() const -> size_t {
+        return tags.size() + main_tokens.size() * sizeof(TokenIndex) +
+               datas.size() * sizeof(NodeData) + extra_data.size() * 4;
+    }
+};
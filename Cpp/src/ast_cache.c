@@ -0,0 +1,346 @@
+#include "ast_cache.h"
+#include "intern.h"
+#include "string_pool.h"
+#include <algorithm>
+#include <dirent.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+// Same steps as hash_bytes(), all 64 bits kept: a cache key can't afford the collisions
+// of a table hash
+auto content_hash(string_view bytes) -> uint64_t {
+    const char* p = bytes.data();
+    size_t n = bytes.size();
+    uint64_t h = 0x9E3779B97F4A7C15 ^ n;
+    for (; n >= 8; p += 8, n -= 8) {
+        uint64_t word;
+        memcpy(&word, p, 8);
+        h = (h ^ word) * 0xBF58476D1CE4E5B9;
+        h ^= h >> 31;
+    }
+    uint64_t tail = 0;
+    memcpy(&tail, p, n);
+    h = (h ^ tail) * 0xBF58476D1CE4E5B9;
+    h ^= h >> 29;
+    h *= 0x94D049BB133111EB;
+    return h ^ (h >> 32);
+}
+
+namespace {
+// content_hash()'s steps over bytes that come in pieces, word by word as if they were
+// one array. An entry is checked with it, a file cut short or written over somewhere
+// in the middle must be a miss and not a tree with indices going anywhere.
+struct PieceHash {
+    uint64_t h = 0x9E3779B97F4A7C15;
+    uint64_t word = 0;
+    uint32_t filled = 0; // bytes of `word` so far
+
+    void add(const char* p, size_t n) {
+        // the rest of a word the last piece ended in
+        while (n && filled) {
+            word |= (uint64_t)(uint8_t)*p++ << 8 * filled++;
+            n--;
+            if (filled == 8) mix();
+        }
+        for (; n >= 8; p += 8, n -= 8) {
+            memcpy(&word, p, 8);
+            mix();
+        }
+        for (; n; p++, n--) word |= (uint64_t)(uint8_t)*p << 8 * filled++;
+    }
+    void mix() {
+        h = (h ^ word) * 0xBF58476D1CE4E5B9;
+        h ^= h >> 31;
+        word = 0;
+        filled = 0;
+    }
+    auto finish() -> uint64_t {
+        uint64_t x = (h ^ word ^ filled) * 0x94D049BB133111EB;
+        return x ^ (x >> 32);
+    }
+};
+
+constexpr char cache_magic[8] = {'D', 'R', 'G', 'A', 'S', 'T', '\n', '\0'};
+
+struct CacheHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t node_kinds; // tags this compiler knows, a new one changes what a tree means
+    uint64_t source_hash;
+    uint64_t payload_hash; // PieceHash of everything after the header
+    uint32_t source_size;
+    uint32_t token_count;
+    uint32_t literal_count;
+    uint32_t node_count;
+    uint32_t extra_count;
+    uint32_t comment_count;
+    uint32_t symbol_count;
+    uint32_t string_count;
+    uint32_t name_bytes;
+    uint32_t unused;
+};
+
+// an interned name or string literal, its bytes are at `offset` in the name bytes
+struct CachedName {
+    uint32_t id;
+    uint32_t offset;
+    uint32_t len;
+};
+
+// Byte offset of each array in an entry, they follow the header in this order
+struct CacheLayout {
+    uint64_t kinds, starts, literal_tokens, literal_values;
+    uint64_t tags, main_tokens, datas, extra_data, comments;
+    uint64_t symbols, strings, name_bytes, end;
+
+    CacheLayout(const CacheHeader& h) {
+        uint64_t at = sizeof(CacheHeader);
+        auto next = [&](uint64_t bytes) {
+            uint64_t start = at;
+            at = (at + bytes + 7) & ~(uint64_t)7;
+            return start;
+        };
+        kinds = next(h.token_count);
+        starts = next(h.token_count * sizeof(ByteOffset));
+        literal_tokens = next(h.literal_count * sizeof(TokenIndex));
+        literal_values = next(h.literal_count * sizeof(uint64_t));
+        tags = next(h.node_count);
+        main_tokens = next(h.node_count * sizeof(TokenIndex));
+        datas = next(h.node_count * sizeof(NodeData));
+        extra_data = next(h.extra_count * sizeof(uint32_t));
+        comments = next(h.comment_count * sizeof(Comment));
+        symbols = next(h.symbol_count * sizeof(CachedName));
+        strings = next(h.string_count * sizeof(CachedName));
+        name_bytes = next(h.name_bytes);
+        end = at;
+    }
+};
+
+// The pieces of an entry in file order, written with writev() straight from the arrays
+// rather than copied into one buffer first
+struct EntryWriter {
+    vector<iovec> pieces;
+    uint64_t size = 0;
+
+    // of the pieces after the first, the header
+    auto payload_hash() const -> uint64_t {
+        PieceHash hash;
+        for (size_t i = 1; i < pieces.size(); i++)
+            hash.add((const char*)pieces[i].iov_base, pieces[i].iov_len);
+        return hash.finish();
+    }
+
+    void add(uint64_t at, const void* data, size_t bytes) {
+        static const char zeros[8] = {};
+        if (at > size) pieces.push_back({(void*)zeros, at - size});
+        if (bytes) pieces.push_back({(void*)data, bytes});
+        size = at + bytes;
+    }
+    template <typename T> void add(uint64_t at, const vector<T>& items) {
+        static_assert(std::is_trivially_copyable_v<T>);
+        add(at, items.data(), items.size() * sizeof(T));
+    }
+
+    auto write_to(int fd) -> bool {
+        for (size_t first = 0; first < pieces.size();) {
+            size_t count = std::min<size_t>(pieces.size() - first, IOV_MAX);
+            ssize_t n = writev(fd, &pieces[first], count);
+            if (n <= 0) return false;
+            // a short write leaves the rest of a piece for the next call
+            while (n > 0 && (size_t)n >= pieces[first].iov_len) n -= pieces[first++].iov_len;
+            if (n > 0) {
+                pieces[first].iov_base = (char*)pieces[first].iov_base + n;
+                pieces[first].iov_len -= n;
+            }
+        }
+        return true;
+    }
+};
+
+template <typename T> void get(const char* entry, uint64_t at, uint32_t count, vector<T>* items) {
+    const T* first = (const T*)(entry + at);
+    items->assign(first, first + count);
+}
+
+// the ids of `pool` the literals of `kind` refer to, sorted, with their bytes
+void collect_names(const TokenList& tokens, TokenKind kind, const Interner& pool,
+                   vector<CachedName>* names, std::string* bytes) {
+    vector<uint32_t> ids;
+    for (uint32_t i = 0; i < tokens.literal_tokens.size(); i++) {
+        if (tokens.kind(tokens.literal_token(i)) == kind)
+            ids.push_back((uint32_t)tokens.literal_values[i]);
+    }
+    std::sort(ids.begin(), ids.end());
+    ids.erase(std::unique(ids.begin(), ids.end()), ids.end());
+    for (uint32_t id : ids) {
+        string_view text = pool.get(id);
+        names->push_back({id, (uint32_t)bytes->size(), (uint32_t)text.size()});
+        bytes->append(text);
+    }
+}
+
+// Interns the names in id order. Within a shard that is the order they were added in
+// the first time, so a pool that hadn't seen any of them gives each its old id back.
+bool intern_names(Interner& pool, const CachedName* names, uint32_t count, const char* bytes) {
+    for (uint32_t i = 0; i < count; i++) {
+        if (pool.intern({bytes + names[i].offset, names[i].len}) != names[i].id) return false;
+    }
+    return true;
+}
+} // namespace
+
+auto AstCache::path_of(uint64_t hash) const -> std::string {
+    char name[64];
+    snprintf(name, sizeof(name), "/%016lx-v%u.ast", (unsigned long)hash, ast_cache_version);
+    return dir + name;
+}
+
+auto AstCache::load(string_view source, TokenList* tokens, CommentTable* comments, Ast* ast)
+    -> bool {
+    uint64_t hash = content_hash(source);
+    int fd = open(path_of(hash).c_str(), O_RDONLY);
+    if (fd < 0) return false;
+    struct stat st;
+    if (fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(CacheHeader)) {
+        close(fd);
+        return false;
+    }
+    // all of it is read, fault it in in one go
+    void* map = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE | MAP_POPULATE, fd, 0);
+    if (map == MAP_FAILED) {
+        close(fd);
+        return false;
+    }
+    const char* entry = (const char*)map;
+    CacheHeader h;
+    memcpy(&h, entry, sizeof(h));
+    CacheLayout at(h);
+    PieceHash payload;
+    bool valid = memcmp(h.magic, cache_magic, sizeof(cache_magic)) == 0 &&
+                 h.version == ast_cache_version && h.node_kinds == Ast_LazyBody + 1 &&
+                 h.source_hash == hash && h.source_size == source.size() &&
+                 at.end == (uint64_t)st.st_size;
+    if (valid) {
+        payload.add(entry + sizeof(h), st.st_size - sizeof(h));
+        valid = payload.finish() == h.payload_hash;
+    }
+    const char* name_bytes = entry + at.name_bytes;
+    bool hit = valid &&
+               intern_names(identifier_pool, (const CachedName*)(entry + at.symbols), h.symbol_count,
+                            name_bytes) &&
+               intern_names(string_pool, (const CachedName*)(entry + at.strings), h.string_count,
+                            name_bytes);
+    if (hit) {
+        get(entry, at.kinds, h.token_count, &tokens->kinds);
+        get(entry, at.starts, h.token_count, &tokens->starts);
+        get(entry, at.literal_tokens, h.literal_count, &tokens->literal_tokens);
+        get(entry, at.literal_values, h.literal_count, &tokens->literal_values);
+        get(entry, at.tags, h.node_count, &ast->tags);
+        get(entry, at.main_tokens, h.node_count, &ast->main_tokens);
+        get(entry, at.datas, h.node_count, &ast->datas);
+        get(entry, at.extra_data, h.extra_count, &ast->extra_data);
+        get(entry, at.comments, h.comment_count, &comments->comments);
+        // recently used, for evict()
+        futimens(fd, nullptr);
+    }
+    munmap(map, st.st_size);
+    close(fd);
+    // a broken entry would only be read and thrown away again, the next store() rewrites it
+    if (!valid) unlink(path_of(hash).c_str());
+    return hit;
+}
+
+// Written to a temporary file and renamed over the entry, so another compiler reading
+// the same entry sees the old one or the new one whole. A cache that can't be written
+// only makes the next run slower, failures are ignored.
+auto AstCache::store(string_view source, const TokenList& tokens, const CommentTable& comments,
+                     const Ast& ast) -> void {
+    vector<CachedName> symbols, strings;
+    std::string name_bytes;
+    collect_names(tokens, Tok_Identifier, identifier_pool, &symbols, &name_bytes);
+    collect_names(tokens, Tok_StringLiteral, string_pool, &strings, &name_bytes);
+
+    CacheHeader h = {};
+    memcpy(h.magic, cache_magic, sizeof(cache_magic));
+    h.version = ast_cache_version;
+    h.node_kinds = Ast_LazyBody + 1;
+    h.source_hash = content_hash(source);
+    h.source_size = source.size();
+    h.token_count = tokens.size();
+    h.literal_count = tokens.literal_tokens.size();
+    h.node_count = ast.size();
+    h.extra_count = ast.extra_data.size();
+    h.comment_count = comments.comments.size();
+    h.symbol_count = symbols.size();
+    h.string_count = strings.size();
+    h.name_bytes = name_bytes.size();
+    CacheLayout at(h);
+
+    EntryWriter out;
+    out.add(0, &h, sizeof(h));
+    out.add(at.kinds, tokens.kinds);
+    out.add(at.starts, tokens.starts);
+    out.add(at.literal_tokens, tokens.literal_tokens);
+    out.add(at.literal_values, tokens.literal_values);
+    out.add(at.tags, ast.tags);
+    out.add(at.main_tokens, ast.main_tokens);
+    out.add(at.datas, ast.datas);
+    out.add(at.extra_data, ast.extra_data);
+    out.add(at.comments, comments.comments);
+    out.add(at.symbols, symbols);
+    out.add(at.strings, strings);
+    out.add(at.name_bytes, name_bytes.data(), name_bytes.size());
+    out.add(at.end, nullptr, 0);
+    h.payload_hash = out.payload_hash(); // the header piece points at `h`
+
+    mkdir(dir.c_str(), 0755);
+    std::string path = path_of(h.source_hash);
+    std::string temp = path + ".tmp" + std::to_string(getpid());
+    int fd = open(temp.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) return;
+    bool written = out.write_to(fd);
+    close(fd);
+    if (!written || rename(temp.c_str(), path.c_str()) != 0) {
+        unlink(temp.c_str());
+        return;
+    }
+    evict();
+}
+
+// least recently used entries first, until the rest fit in max_bytes
+auto AstCache::evict() -> void {
+    DIR* d = opendir(dir.c_str());
+    if (!d) return;
+    struct Entry {
+        std::string path;
+        uint64_t size;
+        struct timespec used;
+    };
+    vector<Entry> entries;
+    uint64_t total = 0;
+    while (struct dirent* e = readdir(d)) {
+        size_t len = strlen(e->d_name);
+        if (len < 4 || strcmp(e->d_name + len - 4, ".ast") != 0) continue;
+        std::string path = dir + "/" + e->d_name;
+        struct stat st;
+        if (stat(path.c_str(), &st) != 0) continue;
+        entries.push_back({path, (uint64_t)st.st_size, st.st_mtim});
+        total += st.st_size;
+    }
+    closedir(d);
+    if (total <= max_bytes) return;
+    std::sort(entries.begin(), entries.end(), [](const Entry& a, const Entry& b) {
+        return a.used.tv_sec != b.used.tv_sec ? a.used.tv_sec < b.used.tv_sec
+                                              : a.used.tv_nsec < b.used.tv_nsec;
+    });
+    for (const Entry& entry : entries) {
+        if (total <= max_bytes) break;
+        if (unlink(entry.path.c_str()) == 0) total -= entry.size;
+    }
+}
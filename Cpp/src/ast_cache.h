@@ -0,0 +1,40 @@
+#pragma once
+#include "ast.h"
+#include "lexer.h"
+#include <stdint.h>
+#include <string>
+
+// Bump when anything stored changes: the token or node layout, a tag's meaning, the
+// lexer's output. Old entries then just stop matching and age out.
+constexpr uint32_t ast_cache_version = 2;
+
+// Parsed files on disk, one file per source content in `dir`, so an unchanged source
+// skips lexing and parsing. An entry is the token list, the tree and the doc comments
+// as they are in memory, each array at an 8 byte aligned offset and every reference an
+// index, so it is mapped and the arrays copied out whole, nothing is decoded node by
+// node. The names and string literals go along with their ids, which are only valid in
+// the process that interned them: a hit interns them again and has to get the very same
+// ids back, as it does in a fresh process, or it counts as a miss.
+//
+// Entries are named by a 64 bit hash of the source and ast_cache_version, and the header
+// holds a hash of the rest of the entry: one that doesn't match it is a miss and is
+// removed, whatever made it so (a bad disk, something else writing over it). A hit marks
+// its entry as used (its mtime), and store() removes the least recently used ones once
+// the directory holds more than `max_bytes`.
+struct AstCache {
+    std::string dir;
+    uint64_t max_bytes = 256ull << 20;
+
+    // fills `tokens`, `comments` and `ast` for `source`, false if it isn't cached
+    auto load(string_view source, TokenList* tokens, CommentTable* comments, Ast* ast) -> bool;
+    // `tokens` and `ast` of an error free parse of `source`, `tokens` settled (see TokenList)
+    auto store(string_view source, const TokenList& tokens, const CommentTable& comments,
+               const Ast& ast) -> void;
+
+  private:
+    auto path_of(uint64_t hash) const -> std::string;
+    auto evict() -> void;
+};
+
+// hash of a whole source file, the cache key
+auto content_hash(string_view bytes) -> uint64_t;
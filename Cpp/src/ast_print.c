@@ -0,0 +1,498 @@
+#include "out_buffer.h"
+#include "parser.h"
+#include "string_pool.h"
+#include "visit.h"
+#include <algorithm>
+#include <math.h>
+#include <unistd.h>
+
+namespace {
+auto is_leaf(NodeKind tag) -> bool {
+    switch (tag) {
+    case Ast_Identifier:
+    case Ast_StringLiteral:
+    case Ast_NumberLiteral:
+    case Ast_FloatLiteral:
+    case Ast_Bool_Not:
+    case Ast_Negation:
+    case Ast_Bit_Not:
+    case Ast_AddressOf:
+    case Ast_Error:
+    case Ast_LazyBody:
+        return true;
+    default:
+        return false;
+    }
+}
+
+// Prints parser.ast the way the classes in tree.h print themselves, without building
+// them: same layout, byte for byte, so the two can be diffed.
+struct TreePrinter : AstWalker<TreePrinter> {
+    Parser& p;
+    OutBuffer& out;
+    int depth = 0;
+
+    TreePrinter(Parser& parser, OutBuffer& _out) : AstWalker{parser.ast}, p(parser), out(_out) {}
+
+    auto text(NodeIndex node) -> string_view { return p.token_at(ast.main_token(node)).buf; }
+    void indent(int level) { out.put_spaces(level * 4); }
+    // `Kind :: text`
+    void line(NodeKind tag, string_view text) {
+        out.put(enum_to_str(tag));
+        out.put(" :: ");
+        out.put(text);
+        out.put('\n');
+    }
+    void open() {
+        depth++;
+        indent(depth);
+        out.put("{\n");
+    }
+    void close() {
+        indent(depth);
+        out.put("}\n");
+        depth--;
+    }
+
+    // everything but the leaves and the binary operators puts its children in braces
+    static auto has_braces(NodeKind tag) -> bool {
+        switch (tag) {
+        case Ast_Pointer:
+        case Ast_Array:
+        case Ast_ParamDecl:
+        case Ast_ParamDeclList:
+        case Ast_Call:
+        case Ast_Block:
+        case Ast_If_Simple:
+        case Ast_VarDecl:
+        case Ast_ConstDecl:
+        case Ast_FnDecl:
+        case Ast_SimpleLoop:
+            return true;
+        default:
+            return false;
+        }
+    }
+
+    // a type spelled out, `[len]` loses its `[` and any length that isn't a single token
+    void print_type(NodeIndex type) {
+        while (true) {
+            switch (ast.tag(type)) {
+            case Ast_Pointer:
+                out.put(text(type));
+                type = ast.data(type).lhs;
+                break;
+            case Ast_Array: {
+                NodeIndex len = ast.data(type).lhs;
+                if (len && is_leaf(ast.tag(len))) out.put(text(len));
+                out.put(']');
+                type = ast.data(type).rhs;
+            } break;
+            default:
+                out.put(text(type));
+                return;
+            }
+        }
+    }
+
+    auto pre(NodeIndex node) -> bool {
+        NodeKind tag = ast.tag(node);
+        if (tag == Ast_Root) return true;
+        indent(depth);
+        out.put("   ");
+        if (is_leaf(tag)) {
+            line(tag, text(node));
+            return false;
+        }
+        switch (tag) {
+        case Ast_Pointer:
+        case Ast_ParamDecl:
+        case Ast_Call:
+            line(tag, text(node));
+            open();
+            return true;
+        case Ast_Array:
+            out.put(enum_to_str(tag));
+            out.put(" :: ");
+            print_type(node);
+            out.put('\n');
+            open();
+            return true;
+        case Ast_ParamDeclList:
+        case Ast_Block:
+            out.put(enum_to_str(tag));
+            out.put('\n');
+            open();
+            return true;
+        case Ast_If_Simple:
+            out.put(enum_to_str(tag));
+            out.put(" ::\n");
+            open();
+            return true;
+        case Ast_VarDecl:
+        case Ast_ConstDecl: {
+            VarDeclInfo info = ast.extra<VarDeclInfo>(ast.data(node).lhs);
+            out.put(tag == Ast_VarDecl ? "VarDecl\n" : "ConstDecl\n");
+            open();
+            indent(depth);
+            out.put("   ");
+            line(Ast_Identifier, text(node));
+            if (info.type) {
+                walk(info.type);
+            } else {
+                indent(depth);
+                out.put(tag == Ast_VarDecl ? "Type :: inferred\n" : "   Type :: inferred\n");
+            }
+            if (info.value) walk(info.value);
+            return false;
+        }
+        case Ast_FnDecl: {
+            FnProto proto = ast.extra<FnProto>(ast.data(node).lhs);
+            out.put(enum_to_str(tag));
+            out.put(":: ");
+            out.put(text(node));
+            out.put(" -> ");
+            print_type(proto.return_type);
+            out.put('\n');
+            open();
+            indent(depth);
+            out.put(" Params : {\n");
+            if (proto.params) walk(proto.params);
+            indent(depth);
+            out.put("}\n");
+            indent(depth);
+            out.put(" Body : {\n");
+            if (ast.data(node).rhs) walk(ast.data(node).rhs);
+            return false;
+        }
+        case Ast_SimpleLoop: {
+            NodeData data = ast.data(node);
+            out.put(enum_to_str(tag));
+            out.put(" {\n");
+            depth++;
+            if (data.lhs) {
+                indent(depth);
+                out.put(" Expression\n");
+                walk(data.lhs);
+            }
+            if (data.rhs) walk(data.rhs);
+            return false;
+        }
+        default:
+            // binary operators, Assign and FieldAccess: no braces around the operands
+            out.put(enum_to_str(tag));
+            out.put(":: ");
+            out.put(text(node));
+            out.put('\n');
+            depth++;
+            return true;
+        }
+    }
+
+    void post(NodeIndex node) {
+        NodeKind tag = ast.tag(node);
+        if (tag == Ast_Root || is_leaf(tag)) return;
+        if (has_braces(tag)) {
+            close();
+        } else {
+            depth--;
+        }
+    }
+};
+
+// What the json and sexpr forms show of a node besides its kind: its children in fixed
+// slots (0 where one is missing) and then any list of them
+struct Shape {
+    uint32_t slot_count = 0;
+    const char* slot_names[3];
+    NodeIndex slots[3];
+    const char* list_name = nullptr;
+    std::span<const NodeIndex> list;
+
+    void slot(const char* name, NodeIndex child) {
+        slot_names[slot_count] = name;
+        slots[slot_count++] = child;
+    }
+};
+
+// Has to know the same per tag layout as for_each_child()
+auto shape_of(const Ast& ast, NodeIndex node) -> Shape {
+    Shape shape;
+    NodeData data = ast.data(node);
+    switch (ast.tag(node)) {
+    case Ast_Identifier:
+    case Ast_StringLiteral:
+    case Ast_NumberLiteral:
+    case Ast_FloatLiteral:
+    case Ast_Bool_Not:
+    case Ast_Negation:
+    case Ast_Bit_Not:
+    case Ast_AddressOf:
+    case Ast_Error:
+    case Ast_LazyBody:
+        break;
+    case Ast_Pointer:
+        shape.slot("base", data.lhs);
+        break;
+    case Ast_Array:
+        shape.slot("len", data.lhs);
+        shape.slot("base", data.rhs);
+        break;
+    case Ast_ParamDecl:
+        shape.slot("type", data.lhs);
+        break;
+    case Ast_Root:
+    case Ast_Block:
+        shape.list_name = "stmts";
+        shape.list = ast.list(node);
+        break;
+    case Ast_ParamDeclList:
+        shape.list_name = "params";
+        shape.list = ast.list(node);
+        break;
+    case Ast_Call:
+        shape.list_name = "args";
+        shape.list = ast.list(ast.extra<SubRange>(data.rhs));
+        break;
+    case Ast_FnDecl: {
+        FnProto proto = ast.extra<FnProto>(data.lhs);
+        shape.slot("params", proto.params);
+        shape.slot("return_type", proto.return_type);
+        shape.slot("body", data.rhs);
+    } break;
+    case Ast_VarDecl:
+    case Ast_ConstDecl: {
+        VarDeclInfo info = ast.extra<VarDeclInfo>(data.lhs);
+        shape.slot("type", info.type);
+        shape.slot("value", info.value);
+    } break;
+    case Ast_If_Simple:
+        shape.slot("condition", data.lhs);
+        shape.slot("block", data.rhs);
+        break;
+    case Ast_SimpleLoop:
+        shape.slot("expr", data.lhs);
+        shape.slot("block", data.rhs);
+        break;
+    default:
+        // binary operators, Assign, FieldAccess
+        shape.slot("lhs", data.lhs);
+        shape.slot("rhs", data.rhs);
+        break;
+    }
+    return shape;
+}
+
+// the tags whose main token says something, a name, a literal or an operator
+auto has_text(NodeKind tag) -> bool {
+    switch (tag) {
+    case Ast_Root:
+    case Ast_Pointer:
+    case Ast_Array:
+    case Ast_ParamDeclList:
+    case Ast_Block:
+    case Ast_If_Simple:
+    case Ast_SimpleLoop:
+    case Ast_LazyBody:
+        return false;
+    default:
+        return true;
+    }
+}
+
+// The tree as JSON or as S-expressions, for tools rather than people.
+//
+// JSON: every node is an object with "kind", "text" (the main token, for the tags in
+// has_text()), "line" and "col" of the main token, and its children under the names
+// shape_of() gives them, null for a missing one. Literals add their "value", a
+// LazyBody the number of "tokens" it skipped. The root is {"kind": "Root", "stmts": [...]}
+// with one top level statement per line.
+//
+// S-expressions: (Kind text child...), the same children in the same order, nil for a
+// missing one and a list's children inline. The text is written as is unless it would
+// break the list, then as a string.
+//
+// The nodes still to write are kept in `steps` rather than on the call stack.
+struct DataPrinter {
+    struct Step {
+        enum Kind : uint8_t {
+            Node,  // `node`, 0 for a missing child
+            Field, // JSON `,"text":` before a named child
+            Text,  // `text` as is
+        } kind;
+        NodeIndex node;
+        const char* text;
+    };
+
+    Parser& p;
+    const Ast& ast;
+    OutBuffer& out;
+    bool json;
+    vector<Step> steps;
+    uint32_t line = 0; // of the last node, counting from 0
+
+    auto text(NodeIndex node) -> string_view { return p.token_at(ast.main_token(node)).buf; }
+
+    void put_atom(NodeKind tag, string_view text) {
+        bool plain = !text.empty() && (tag == Ast_StringLiteral ||
+                                       text.find_first_of(" \t\r\n()\";") == string_view::npos);
+        if (plain) {
+            out.put(text);
+        } else {
+            out.put_json_string(text);
+        }
+    }
+
+    // Nodes come out about in source order, so the main token is mostly on the line of
+    // the last one or the one after, and only otherwise looked up
+    void put_location(NodeIndex node) {
+        const vector<ByteOffset>& starts = p.lines.line_starts;
+        ByteOffset offset = p.start_at(ast.main_token(node));
+        auto on = [&](uint32_t i) {
+            return i < starts.size() && offset >= starts[i] &&
+                   (i + 1 == starts.size() || offset < starts[i + 1]);
+        };
+        if (!on(line))
+            line = on(line + 1) ? line + 1 : p.location_of(ast.main_token(node)).line - 1;
+        out.put(",\"line\":");
+        out.put_uint(line + 1);
+        out.put(",\"col\":");
+        out.put_uint(offset - starts[line] + 1);
+    }
+
+    void put_value(NodeIndex node) {
+        NodeData data = ast.data(node);
+        switch (ast.tag(node)) {
+        case Ast_NumberLiteral:
+            out.put(",\"value\":");
+            out.put_uint((uint64_t)data.rhs << 32 | data.lhs);
+            break;
+        case Ast_FloatLiteral: {
+            uint64_t bits = (uint64_t)data.rhs << 32 | data.lhs;
+            double value;
+            memcpy(&value, &bits, sizeof(value));
+            out.put(",\"value\":");
+            if (isfinite(value)) {
+                out.put_double(value);
+            } else {
+                out.put("null");
+            }
+        } break;
+        case Ast_StringLiteral:
+            out.put(",\"value\":");
+            out.put_json_string(string_pool.get(data.lhs));
+            break;
+        case Ast_LazyBody:
+            out.put(",\"tokens\":");
+            out.put_uint(data.lhs);
+            break;
+        default:
+            break;
+        }
+    }
+
+    // writes what comes before the children of `node` and queues the rest
+    void open(NodeIndex node) {
+        NodeKind tag = ast.tag(node);
+        if (json) {
+            out.put("{\"kind\":\"");
+            out.put(enum_to_str(tag));
+            out.put('"');
+            if (has_text(tag)) {
+                out.put(",\"text\":");
+                out.put_json_string(text(node));
+            }
+            put_location(node);
+            put_value(node);
+        } else {
+            out.put('(');
+            out.put(enum_to_str(tag));
+            if (has_text(tag)) {
+                out.put(' ');
+                put_atom(tag, text(node));
+            } else if (tag == Ast_LazyBody) {
+                out.put(' ');
+                out.put_uint(ast.data(node).lhs);
+            }
+        }
+
+        // queued in order, then reversed so the first one is on top
+        Shape shape = shape_of(ast, node);
+        size_t first = steps.size();
+        for (uint32_t i = 0; i < shape.slot_count; i++) {
+            steps.push_back(json ? Step{Step::Field, 0, shape.slot_names[i]}
+                                 : Step{Step::Text, 0, " "});
+            steps.push_back({Step::Node, shape.slots[i], nullptr});
+        }
+        if (shape.list_name) {
+            if (json) {
+                steps.push_back({Step::Field, 0, shape.list_name});
+                steps.push_back({Step::Text, 0, "["});
+            }
+            for (size_t i = 0; i < shape.list.size(); i++) {
+                if (i > 0 || !json) steps.push_back({Step::Text, 0, json ? "," : " "});
+                steps.push_back({Step::Node, shape.list[i], nullptr});
+            }
+            if (json) steps.push_back({Step::Text, 0, "]"});
+        }
+        steps.push_back({Step::Text, 0, json ? "}" : ")"});
+        std::reverse(steps.begin() + first, steps.end());
+    }
+
+    void print(NodeIndex node) {
+        steps.push_back({Step::Node, node, nullptr});
+        while (!steps.empty()) {
+            Step step = steps.back();
+            steps.pop_back();
+            switch (step.kind) {
+            case Step::Node:
+                if (step.node) {
+                    open(step.node);
+                } else {
+                    out.put(json ? "null" : "nil");
+                }
+                break;
+            case Step::Field:
+                out.put(",\"");
+                out.put(step.text);
+                out.put("\":");
+                break;
+            case Step::Text:
+                out.put(step.text);
+                break;
+            }
+        }
+    }
+
+    // the root by hand, to put each top level statement on a line of its own
+    void print_root() {
+        out.put(json ? "{\"kind\":\"Root\",\"stmts\":[" : "(Root");
+        bool first = true;
+        for (NodeIndex stmt : ast.list(0)) {
+            out.put(json && !first ? ",\n" : "\n");
+            if (!json) out.put("  ");
+            print(stmt);
+            first = false;
+        }
+        out.put(json ? "\n]}\n" : ")\n");
+    }
+};
+} // namespace
+
+auto Parser::emit_ast(OutBuffer& out, EmitFormat format) -> void {
+    if (format == Emit_Tree) {
+        TreePrinter printer(*this, out);
+        printer.walk(0);
+        return;
+    }
+    if (!lines.is_built()) lines.build(source);
+    DataPrinter printer = {*this, ast, out, format == Emit_Json, {}};
+    printer.print_root();
+}
+
+auto Parser::print_tree() -> void {
+    // anything printf() still has buffered goes first
+    fflush(stdout);
+    OutBuffer out(STDOUT_FILENO);
+    emit_ast(out, Emit_Tree);
+}
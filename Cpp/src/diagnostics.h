@@ -21,17 +21,22 @@
 #define Color_Dim "\x1b[2m"
 #define Color_Reset "\x1b[0m"
 
+// fatal, the process exits with 1
 #define print_error(msg, ...)                                                  \
-  fprintf(stderr,                                                              \
-          Color_Red "error:" Color_Reset "[ %s : %d : %s() ]\n=> " msg "\n",   \
-          __FILE__, __LINE__, __func__ __VA_OPT__(, ) __VA_ARGS__);            \
-  exit(0)
+  do {                                                                         \
+    fprintf(stderr,                                                            \
+            Color_Red "error:" Color_Reset "[ %s : %d : %s() ]\n=> " msg "\n", \
+            __FILE__, __LINE__, __func__ __VA_OPT__(, ) __VA_ARGS__);          \
+    exit(1);                                                                   \
+  } while (0)
 
 #define print_warning(msg, ...)                                                \
-  fprintf(stderr,                                                              \
-          Color_Yellow "warning:" Color_Reset "[ %s : %d : %s() ]\n=> " msg    \
-                       "\n",                                                   \
-          __FILE__, __LINE__, __func__ __VA_OPT__(, ) __VA_ARGS__);            \
-  exit(0)
+  do {                                                                         \
+    fprintf(stderr,                                                            \
+            Color_Yellow "warning:" Color_Reset "[ %s : %d : %s() ]\n=> " msg  \
+                         "\n",                                                 \
+            __FILE__, __LINE__, __func__ __VA_OPT__(, ) __VA_ARGS__);          \
+    exit(0);                                                                   \
+  } while (0)
 
 
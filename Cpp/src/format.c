@@ -0,0 +1,310 @@
+#include "format.h"
+#include "parser.h"
+#include <string.h>
+
+namespace {
+auto is_space(char c) -> bool { return c == ' ' || c == '\t' || c == '\n' || c == '\r'; }
+
+// operators that are always binary, the others are marked from the tree
+auto is_assign_or_arrow(TokenKind kind) -> bool {
+    switch (kind) {
+    case Tok_Equal:
+    case Tok_PlusEqual:
+    case Tok_MinusEqual:
+    case Tok_AsteriskEqual:
+    case Tok_SlashEqual:
+    case Tok_ColonEqual:
+    case Tok_Arrow:
+    case Tok_EqualAngleBracketRt:
+        return true;
+    default:
+        return false;
+    }
+}
+
+auto is_binary(NodeKind tag) -> bool {
+    switch (tag) {
+    case Ast_Mul:
+    case Ast_Add:
+    case Ast_Sub:
+    case Ast_Div:
+    case Ast_Bool_Or:
+    case Ast_Bool_And:
+    case Ast_Bit_Xor:
+    case Ast_Bit_And:
+    case Ast_Bit_Or:
+    case Ast_ShiftLeft:
+    case Ast_ShiftRight:
+    case Ast_LessThan:
+    case Ast_GreaterThan:
+    case Ast_EqualEqual:
+    case Ast_NotEqual:
+    case Ast_Assign:
+        return true;
+    default:
+        return false;
+    }
+}
+
+// `-x`, `!x`, `~x`, `&x` and the `*` of pointer types, when they aren't binary
+auto is_prefix(TokenKind kind) -> bool {
+    return kind == Tok_Minus || kind == Tok_Bang || kind == Tok_Tilde || kind == Tok_Ambersand ||
+           kind == Tok_Asterisk;
+}
+
+// between two tokens on the same line, `spaced` as in Formatter::spaced
+auto space_between(TokenKind prev, bool prev_spaced, TokenKind next, bool next_spaced) -> bool {
+    if (prev_spaced || next_spaced) return true;
+    if (is_prefix(prev)) return false;
+    // `]` ends the length of an array type, the element type follows right after it
+    if (prev == Tok_LParen || prev == Tok_LBracket || prev == Tok_Dot || prev == Tok_RBracket)
+        return false;
+    switch (next) {
+    case Tok_RParen:
+    case Tok_RBracket:
+    case Tok_Comma:
+    case Tok_Semicolon:
+    case Tok_Colon:
+    case Tok_Dot:
+        return false;
+    case Tok_LParen:
+    case Tok_LBracket:
+        // calls and indexing, but `if (`
+        return prev != Tok_Identifier && prev != Tok_RParen;
+    default:
+        return true;
+    }
+}
+
+// Writes the tokens and comments of a file in order, deciding before each one whether it
+// goes on a new line and how far that's indented, or else whether a space comes first.
+struct Printer {
+    string_view source;
+    const TokenList& tokens;
+    const vector<Comment>& comments;
+    const vector<uint8_t>& spaced;
+    OutBuffer& out;
+    bool check;
+
+    uint32_t next_comment = 0;
+    TokenIndex next_token = 0; // the first token not written yet
+    uint32_t depth = 0;  // open braces
+    uint32_t parens = 0; // open parentheses and brackets, a `;` in them ends nothing
+    ByteOffset last_end = 0; // end of the last token or comment written
+    TokenKind last = Tok_Eof; // the last token written, Tok_Eof before the first
+    bool last_spaced = false;
+    bool after_comment = false; // a comment was written after `last`
+    bool line_ended = false;    // the next token goes on a new line, whatever the source did
+    bool in_statement = false;  // the current line is part of a statement that isn't over
+    // check mode: how much of the source the lines written so far matched, they are dropped
+    // from `out` once they did
+    size_t matched = 0;
+    bool differs = false;
+
+    // newlines between the last thing written and `offset`, only whether it's 0, 1 or more
+    auto newlines_before(ByteOffset offset) const -> uint32_t {
+        uint32_t count = 0;
+        // the gap is a space or two most of the time
+        for (ByteOffset i = last_end; i < offset; i++) {
+            if (source[i] == '\n' && ++count == 2) break;
+        }
+        return count;
+    }
+
+    // ends the current line, with a blank line after it if `blank`, and indents the next
+    void new_line(bool blank, uint32_t indent) {
+        if (!out.bytes.empty() || matched) {
+            out.put('\n');
+            if (blank) out.put('\n');
+            if (check) compare_lines();
+        }
+        out.bytes.append(indent, '\t');
+    }
+
+    void compare_lines() {
+        size_t size = out.bytes.size();
+        if (matched + size > source.size() ||
+            memcmp(out.bytes.data(), source.data() + matched, size) != 0) {
+            differs = true;
+            return;
+        }
+        matched += size;
+        out.bytes.clear();
+    }
+
+    // blank lines are kept between statements and comments, but not right after a `{`
+    auto after_block_start() const -> bool { return last != Tok_LBrace || after_comment; }
+
+    // the comments before `offset`
+    void print_comments(ByteOffset offset) {
+        for (; next_comment < comments.size(); next_comment++) {
+            const Comment& comment = comments[next_comment];
+            if (comment.start >= offset) break;
+            bool first = out.bytes.empty() && !matched;
+            uint32_t newlines = newlines_before(comment.start);
+            if (!first && newlines == 0) {
+                // stays at the end of the line it's on
+                out.put(' ');
+            } else {
+                new_line(newlines > 1 && !in_statement && after_block_start(),
+                         depth + in_statement);
+            }
+            string_view text = source.substr(comment.start, comment.len);
+            if (comment.kind != Comment_Block) {
+                while (!text.empty() && is_space(text.back())) text.remove_suffix(1);
+                // nothing can follow a line comment on its line
+                line_ended = true;
+            }
+            out.put(text);
+            last_end = comment.start + comment.len;
+            after_comment = true;
+        }
+    }
+
+    auto token_end(TokenIndex i, ByteOffset start) const -> ByteOffset {
+        ByteOffset end = tokens.start(i + 1);
+        if (next_comment < comments.size() && comments[next_comment].start < end)
+            end = comments[next_comment].start;
+        while (end > start && is_space(source[end - 1])) end--;
+        return end;
+    }
+
+    void print_token(TokenIndex i) {
+        TokenKind kind = tokens.kind(i);
+        ByteOffset start = tokens.start(i);
+        print_comments(start);
+        ByteOffset end = token_end(i, start);
+        bool is_spaced = spaced[i];
+
+        if (kind == Tok_RBrace && depth > 0) depth--;
+        uint32_t newlines = newlines_before(start);
+        // a statement broken over lines stays broken there, but not before a `{`, `;` or `,`
+        bool source_break = newlines > 0 &&
+                            (after_comment || (kind != Tok_LBrace && kind != Tok_Semicolon &&
+                                               kind != Tok_Comma));
+        if (out.bytes.empty() && !matched) {
+            // the first line
+        } else if (kind == Tok_RBrace || ((line_ended || source_break) && !in_statement)) {
+            new_line(newlines > 1 && after_block_start() && kind != Tok_RBrace, depth);
+        } else if (line_ended || source_break) {
+            // one more tab for the rest of the statement, a closing `)` or `]` lines up
+            // with where it started
+            bool closes = kind == Tok_RParen || kind == Tok_RBracket;
+            new_line(false, depth + !closes);
+        } else if (after_comment || space_between(last, last_spaced, kind, is_spaced)) {
+            out.put(' ');
+        }
+        out.put(source.substr(start, end - start));
+
+        last = kind;
+        last_spaced = is_spaced;
+        last_end = end;
+        after_comment = false;
+        line_ended = false;
+        switch (kind) {
+        case Tok_LBrace:
+            depth++;
+            line_ended = true;
+            break;
+        case Tok_RBrace:
+            line_ended = true;
+            break;
+        case Tok_Semicolon:
+            line_ended = parens == 0;
+            break;
+        case Tok_LParen:
+        case Tok_LBracket:
+            parens++;
+            break;
+        case Tok_RParen:
+        case Tok_RBracket:
+            if (parens > 0) parens--;
+            break;
+        default:
+            break;
+        }
+        in_statement = !line_ended;
+    }
+
+    // the tokens before `end`, never the Eof token, or fewer once a line came out different
+    void print_tokens(TokenIndex end) {
+        end = std::min(end, tokens.size() - 1);
+        for (; next_token < end && !differs; next_token++) print_token(next_token);
+    }
+
+    // the comments after the last token and the newline that ends the file
+    void finish() {
+        if (differs) return;
+        print_comments(source.size());
+        if (!out.bytes.empty()) out.put('\n');
+        if (check) compare_lines();
+    }
+};
+} // namespace
+
+auto Formatter::format(string_view source, bool check) -> FormatResult {
+    out.bytes.clear();
+    error.clear();
+    comments.comments.clear();
+    // the names don't matter here, only the text
+    Parser parser(source, tokenize(source, &comments, nullptr, nullptr));
+    // bytes that aren't tokens, the parser would only see something unexpected there
+    for (TokenIndex i = 0; i < parser.tokens.size(); i++) {
+        if (parser.tokens.kind(i) != Tok_Invalid) continue;
+        Location loc = parser.location_of(i);
+        Token token = parser.token_at(i);
+        error = std::to_string(loc.line) + ":" + std::to_string(loc.column) + ": invalid token `";
+        error += token.buf;
+        error += "`";
+        return Format_Error;
+    }
+    auto syntax_error = [&] {
+        const Error& first = parser.errors[0];
+        Location loc = parser.location_of(first.token);
+        error = std::to_string(loc.line) + ":" + std::to_string(loc.column) + ": ";
+        if (first.kind == error_expected_token) {
+            error += "expected ";
+            error += enum_to_str(first.expected);
+        } else {
+            error += first.msg;
+        }
+        return Format_Error;
+    };
+
+    const TokenList& tokens = parser.tokens;
+    const Ast& ast = parser.ast;
+    spaced.assign(tokens.size(), 0);
+    for (TokenIndex i = 0; i < tokens.size(); i++) spaced[i] = is_assign_or_arrow(tokens.kind(i));
+    auto mark_binary = [&](NodeIndex first) {
+        for (NodeIndex i = first; i < ast.size(); i++) {
+            if (is_binary(ast.tag(i))) spaced[ast.main_token(i)] = 1;
+        }
+    };
+    Printer printer = {source, tokens, comments.comments, spaced, out, check};
+
+    if (check) {
+        // a statement at a time, each one written and compared before the next is parsed,
+        // so a file that isn't formatted is only parsed up to its first line that differs
+        parser.ast.add_node(Ast_Root, 0, {0, 0});
+        while (parser.current != Tok_Eof) {
+            NodeIndex first = ast.size();
+            parser.parseTopLevel();
+            if (parser.has_errors()) return syntax_error();
+            mark_binary(first);
+            printer.print_tokens(parser.index);
+            if (printer.differs) return Format_Changed;
+        }
+        printer.finish();
+        bool same = !printer.differs && printer.matched == source.size();
+        return same ? Format_Same : Format_Changed;
+    }
+
+    parser.parseRoot();
+    if (parser.has_errors()) return syntax_error();
+    mark_binary(1);
+    printer.print_tokens(tokens.size());
+    printer.finish();
+    bool same = out.bytes.size() == source.size() &&
+                memcmp(out.bytes.data(), source.data(), source.size()) == 0;
+    return same ? Format_Same : Format_Changed;
+}
@@ -0,0 +1,47 @@
+#pragma once
+#include "lexer.h"
+#include "out_buffer.h"
+#include <stdint.h>
+#include <string>
+
+// What Formatter::format() found out about a source
+enum FormatResult {
+    Format_Same,    // formatted already
+    Format_Changed, // not formatted, `out` has the formatted text (unless checking)
+    Format_Error,   // invalid tokens or syntax errors, left alone, `error` says where the
+                    // first one is
+};
+
+// The drgfmt style, made from the tokens alone, the source's own spacing is thrown away:
+// - one statement per line, indented with a tab per open `{`, lines that carry on a
+//   statement the source broke over several get one more
+// - `{` ends the line of its `if`, `for` or `fn`, `}` is on a line of its own
+// - binary operators, `=` and `->` have a space on both sides, `,` and `:` one after,
+//   nothing goes inside parentheses and brackets or after a prefix operator
+// - at most one blank line in a row, where the source had any, none at the start of a
+//   block or before its `}`
+// - comments stay where they were: at the end of the line of the token before them, or
+//   on a line of their own indented like the code around them
+//
+// Which `-`, `*` or `&` is a binary operator the tokens can't tell (`[4]*T` vs `a * b`),
+// so the file is parsed and the operator tokens of the tree are the binary ones. Files
+// with bytes that don't lex or with syntax errors aren't formatted, what they mean is a
+// guess.
+//
+// One Formatter is meant to format many files one after the other, `out` and the
+// comment table keep their memory from one to the next. Names and strings aren't
+// interned, a run over many files leaves the shared pools as they were.
+struct Formatter {
+    OutBuffer out; // fd -1, the text stays in `out.bytes` until the caller writes it
+    std::string error;
+
+    // With `check` set, only finds out whether `source` is formatted: it stops at the
+    // first line that comes out different, and `out` is left with the lines it was on.
+    // The file is parsed a top level statement at a time as it goes, so a syntax error
+    // past that line isn't seen and the file is just not formatted.
+    auto format(string_view source, bool check = false) -> FormatResult;
+
+  private:
+    CommentTable comments = {Comments_All, {}};
+    vector<uint8_t> spaced; // per token, whether it gets a space on both sides
+};
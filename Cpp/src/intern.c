@@ -0,0 +1,193 @@
+#include "intern.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+Interner identifier_pool;
+
+// the `n` < 8 bytes at `p` zero extended, without the libc call a variable size
+// memcpy turns into. Overlapping loads, so nothing past `p + n` is read.
+static inline uint64_t load_tail(const char* p, size_t n) {
+    if (n >= 4) {
+        uint32_t lo, hi;
+        memcpy(&lo, p, 4);
+        memcpy(&hi, p + n - 4, 4);
+        return lo | (uint64_t)hi << 8 * (n - 4);
+    }
+    if (n == 0) return 0;
+    uint8_t a = p[0], b = p[n / 2], c = p[n - 1];
+    return a | (uint64_t)b << 8 * (n / 2) | (uint64_t)c << 8 * (n - 1);
+}
+
+static inline bool same_bytes(const char* a, const char* b, size_t n) {
+    if (n < 8) return load_tail(a, n) == load_tail(b, n);
+    for (size_t i = 0; i + 8 < n; i += 8) {
+        uint64_t x, y;
+        memcpy(&x, a + i, 8);
+        memcpy(&y, b + i, 8);
+        if (x != y) return false;
+    }
+    // the last 8, overlapping the ones before
+    uint64_t x, y;
+    memcpy(&x, a + n - 8, 8);
+    memcpy(&y, b + n - 8, 8);
+    return x == y;
+}
+
+// 8 bytes per step multiply-xorshift, good enough for an open addressing table
+auto hash_bytes(std::string_view bytes) -> uint32_t {
+    const char* p = bytes.data();
+    size_t n = bytes.size();
+    uint64_t h = 0x9E3779B97F4A7C15 ^ n;
+    for (; n >= 8; p += 8, n -= 8) {
+        uint64_t word;
+        memcpy(&word, p, 8);
+        h = (h ^ word) * 0xBF58476D1CE4E5B9;
+        h ^= h >> 31;
+    }
+    if (n) h = (h ^ load_tail(p, n)) * 0xBF58476D1CE4E5B9;
+    h ^= h >> 29;
+    h *= 0x94D049BB133111EB;
+    return (uint32_t)(h >> 32);
+}
+
+auto Interner::new_table(uint32_t size) -> Table* {
+    Table* table = new Table{size - 1, new std::atomic<uint64_t>[size]};
+    for (uint32_t i = 0; i < size; i++) table->slots[i].store(0, std::memory_order_relaxed);
+    return table;
+}
+
+Interner::Interner() {
+    for (Shard& shard : shards) {
+        Table* table = new_table(256);
+        shard.tables.push_back(table);
+        shard.table.store(table, std::memory_order_relaxed);
+        for (auto& block : shard.blocks) block.store(nullptr, std::memory_order_relaxed);
+        shard.count.store(0, std::memory_order_relaxed);
+        shard.stored_bytes.store(0, std::memory_order_relaxed);
+    }
+}
+
+Interner::~Interner() {
+    for (Shard& shard : shards) {
+        for (Table* table : shard.tables) {
+            delete[] table->slots;
+            delete table;
+        }
+        for (auto& block : shard.blocks) delete[] block.load(std::memory_order_relaxed);
+        for (char* chunk : shard.chunks) free(chunk);
+    }
+}
+
+auto Interner::entry(const Shard& shard, uint32_t index) -> Entry* {
+    uint32_t biased = index + (1u << first_block_bits);
+    uint32_t top = 31 - __builtin_clz(biased);
+    Entry* block = shard.blocks[top - first_block_bits].load(std::memory_order_acquire);
+    return &block[biased - (1u << top)];
+}
+
+// index + 1 of `bytes` in the table, or 0 and the empty slot where it would go
+auto Interner::find(const Shard& shard, const Table* table, std::string_view bytes,
+                    uint32_t hash, uint32_t* slot) -> uint32_t {
+    for (uint32_t i = hash & table->mask;; i = (i + 1) & table->mask) {
+        uint64_t value = table->slots[i].load(std::memory_order_acquire);
+        if (!value) {
+            *slot = i;
+            return 0;
+        }
+        if ((uint32_t)(value >> 32) != hash) continue;
+        const Entry* e = entry(shard, (uint32_t)value - 1);
+        if (e->len == bytes.size() && same_bytes(e->text, bytes.data(), bytes.size()))
+            return (uint32_t)value;
+    }
+}
+
+// copies the bytes into the shard's arena, strings never move once stored
+auto Interner::store(Shard& shard, std::string_view bytes) -> const char* {
+    if (bytes.size() > chunk_size / 4) {
+        char* big = (char*)malloc(bytes.size() ? bytes.size() : 1);
+        memcpy(big, bytes.data(), bytes.size());
+        shard.chunks.push_back(big);
+        return big;
+    }
+    if (shard.chunk_used + bytes.size() > chunk_size) {
+        shard.chunk = (char*)malloc(chunk_size);
+        shard.chunks.push_back(shard.chunk);
+        shard.chunk_used = 0;
+    }
+    char* dest = shard.chunk + shard.chunk_used;
+    memcpy(dest, bytes.data(), bytes.size());
+    shard.chunk_used += bytes.size();
+    return dest;
+}
+
+// the old table stays around (and valid) for readers that already loaded it
+void Interner::grow(Shard& shard) {
+    Table* old = shard.table.load(std::memory_order_relaxed);
+    Table* table = new_table((old->mask + 1) * 2);
+    for (uint32_t i = 0; i <= old->mask; i++) {
+        uint64_t value = old->slots[i].load(std::memory_order_relaxed);
+        if (!value) continue;
+        uint32_t j = (uint32_t)(value >> 32) & table->mask;
+        while (table->slots[j].load(std::memory_order_relaxed)) j = (j + 1) & table->mask;
+        table->slots[j].store(value, std::memory_order_relaxed);
+    }
+    shard.tables.push_back(table);
+    shard.table.store(table, std::memory_order_release);
+}
+
+auto Interner::intern(std::string_view bytes, uint32_t hash) -> SymbolId {
+    uint32_t shard_index = hash >> (32 - shard_bits);
+    Shard& shard = shards[shard_index];
+    uint32_t slot;
+
+    // most strings are already there, look for them without the lock first
+    const Table* seen = shard.table.load(std::memory_order_acquire);
+    if (uint32_t found = find(shard, seen, bytes, hash, &slot))
+        return (found - 1) << shard_bits | shard_index;
+
+    std::lock_guard<std::mutex> guard(shard.lock);
+    // another thread may have added it, or grown the table, since
+    Table* table = shard.table.load(std::memory_order_relaxed);
+    if (uint32_t found = find(shard, table, bytes, hash, &slot))
+        return (found - 1) << shard_bits | shard_index;
+
+    uint32_t index = shard.count.load(std::memory_order_relaxed);
+    if (index + 1 >= max_entries) {
+        fprintf(stderr, "too many distinct names, the interner is limited to %u per shard\n",
+                max_entries);
+        exit(1);
+    }
+    uint32_t biased = index + (1u << first_block_bits);
+    uint32_t top = 31 - __builtin_clz(biased);
+    if (biased == 1u << top) {
+        // first entry of a new block
+        Entry* block = new Entry[1u << top];
+        shard.blocks[top - first_block_bits].store(block, std::memory_order_release);
+    }
+    *entry(shard, index) = {store(shard, bytes), (uint32_t)bytes.size()};
+    // publishes the entry to the lock free readers
+    table->slots[slot].store((uint64_t)hash << 32 | (index + 1), std::memory_order_release);
+    shard.count.store(index + 1, std::memory_order_relaxed);
+    shard.stored_bytes.fetch_add(bytes.size(), std::memory_order_relaxed);
+    // keep the load factor under 1/2
+    if ((index + 1) * 2 > table->mask + 1) grow(shard);
+    return index << shard_bits | shard_index;
+}
+
+auto Interner::get(SymbolId id) const -> std::string_view {
+    const Entry* e = entry(shards[id & (shard_count - 1)], id >> shard_bits);
+    return {e->text, e->len};
+}
+
+auto Interner::size() const -> uint32_t {
+    uint32_t total = 0;
+    for (const Shard& shard : shards) total += shard.count.load(std::memory_order_relaxed);
+    return total;
+}
+
+auto Interner::bytes() const -> size_t {
+    size_t total = 0;
+    for (const Shard& shard : shards) total += shard.stored_bytes.load(std::memory_order_relaxed);
+    return total;
+}
@@ -0,0 +1,85 @@
+#pragma once
+#include <atomic>
+#include <mutex>
+#include <stdint.h>
+#include <string_view>
+#include <vector>
+
+using SymbolId = uint32_t;
+
+// not a valid id, for names that aren't there (a missing identifier after an error)
+constexpr SymbolId no_symbol = UINT32_MAX;
+
+auto hash_bytes(std::string_view bytes) -> uint32_t;
+
+// Deduplicated byte strings with 32 bit ids. Every distinct string is stored once and
+// keeps its id and address for the life of the interner, so two names are the same
+// name exactly when their ids are equal.
+//
+// Safe to intern into from any number of threads. The strings are split into shards
+// by hash, each with its own lock, arena and open addressing table, and looking up a
+// string that is already there doesn't take the lock at all. After the first few
+// thousand names nearly every lookup is a hit, so lexer threads only wait on each
+// other when two of them add a new string to the same shard at the same time.
+struct Interner {
+    Interner();
+    Interner(const Interner&) = delete;
+    Interner& operator=(const Interner&) = delete;
+    ~Interner();
+
+    auto intern(std::string_view bytes) -> SymbolId { return intern(bytes, hash_bytes(bytes)); }
+    // `hash` must be hash_bytes(bytes), for callers that already have it
+    auto intern(std::string_view bytes, uint32_t hash) -> SymbolId;
+    auto get(SymbolId id) const -> std::string_view;
+    auto size() const -> uint32_t;
+    auto bytes() const -> size_t;
+
+  private:
+    // ids are (index in the shard << shard_bits) | shard
+    static constexpr uint32_t shard_bits = 4;
+    static constexpr uint32_t shard_count = 1 << shard_bits;
+    static constexpr uint32_t max_entries = 1u << (32 - shard_bits);
+    // entries live in blocks that double in size and never move, block k holds
+    // first_block << k of them
+    static constexpr uint32_t first_block_bits = 8;
+    static constexpr uint32_t max_blocks = 32 - shard_bits - first_block_bits + 1;
+    static constexpr uint32_t chunk_size = 64 * 1024;
+
+    struct Entry {
+        const char* text;
+        uint32_t len;
+    };
+
+    // slots are hash << 32 | (index + 1), 0 is empty. Never shrinks and never
+    // drops an entry, so a reader on an old table can only miss strings, not
+    // find wrong ones.
+    struct Table {
+        uint32_t mask;
+        std::atomic<uint64_t>* slots;
+    };
+
+    struct alignas(64) Shard {
+        std::mutex lock;
+        std::atomic<Table*> table;
+        std::atomic<Entry*> blocks[max_blocks];
+        std::atomic<uint32_t> count;
+        std::atomic<size_t> stored_bytes;
+        // only touched with the lock held
+        std::vector<Table*> tables; // every table so far, readers may still be on old ones
+        std::vector<char*> chunks;
+        char* chunk = nullptr;
+        uint32_t chunk_used = chunk_size;
+    };
+
+    Shard shards[shard_count];
+
+    static auto new_table(uint32_t size) -> Table*;
+    static auto entry(const Shard& shard, uint32_t index) -> Entry*;
+    static auto store(Shard& shard, std::string_view bytes) -> const char*;
+    static auto find(const Shard& shard, const Table* table, std::string_view bytes,
+                     uint32_t hash, uint32_t* slot) -> uint32_t;
+    static void grow(Shard& shard);
+};
+
+// identifier names, filled in by the lexer
+extern Interner identifier_pool;
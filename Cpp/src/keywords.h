@@ -0,0 +1,57 @@
+#pragma once
+#include "../../shared/keywords.h"
+#include "lexer.h"
+#include <stdint.h>
+#include <string.h>
+
+// Keywords are found with a perfect hash over (first byte, last byte, length), all of
+// which the lexer already has once an identifier is scanned, so classifying it takes
+// one table probe and one memcmp. The list and the hash are in shared/keywords.h, the C
+// frontend builds its switch from the same ones.
+
+constexpr uint32_t keyword_table_size = KEYWORD_TABLE_SIZE;
+
+constexpr auto keyword_hash(char first, char last, uint32_t len) -> uint32_t {
+    return KEYWORD_HASH(first, last, len);
+}
+
+struct Keyword {
+    string_view text;
+    TokenKind kind = Tok_Identifier;
+    char first = 0, last = 0;
+};
+
+constexpr Keyword keyword_list[] = {
+#define X(text, kind, first, last) {text, kind, first, last},
+    KEYWORD_LIST(X)
+#undef X
+};
+
+struct KeywordTable {
+    Keyword slots[keyword_table_size];
+    bool is_perfect = true;
+    bool chars_match = true;
+};
+
+constexpr auto make_keyword_table() -> KeywordTable {
+    KeywordTable table = {};
+    for (const Keyword& kw : keyword_list) {
+        Keyword& slot = table.slots[keyword_hash(kw.text.front(), kw.text.back(), kw.text.size())];
+        if (!slot.text.empty()) table.is_perfect = false;
+        if (kw.first != kw.text.front() || kw.last != kw.text.back()) table.chars_match = false;
+        slot = kw;
+    }
+    return table;
+}
+
+constexpr KeywordTable keyword_table = make_keyword_table();
+static_assert(keyword_table.is_perfect, "keyword_hash collides, pick new multipliers");
+static_assert(keyword_table.chars_match, "KEYWORD_LIST has a first or last char wrong");
+
+// `ident` must not be empty
+inline auto keyword_kind(string_view ident) -> TokenKind {
+    const Keyword& kw = keyword_table.slots[keyword_hash(ident.front(), ident.back(), ident.size())];
+    if (kw.text.size() == ident.size() && memcmp(kw.text.data(), ident.data(), ident.size()) == 0)
+        return kw.kind;
+    return Tok_Identifier;
+}
@@ -1,8 +1,15 @@
 #include "lexer.h"
+#include "keywords.h"
 #include "lib.h"
+#include "number.h"
+#include "operators.h"
+#include "scan.h"
+#include "unicode.h"
+#include <algorithm>
 #include <assert.h>
 #include <cstring>
 #include <stdio.h>
+#include <thread>
 
 inline bool is_equal(const char* s1, const char* s2) {
     auto s1_len = strlen(s1);
@@ -12,127 +19,92 @@ inline bool is_equal(const char* s1, const char* s2) {
     return (memcmp(s1, s2, strlen(s1)) == 0);
 }
 
-//@Leak
+char Lexer::advance_char() { return source.data()[index++]; }
 
-//@Leak
-string read_file(const char* file_name) {
-    FILE* fp = fopen(file_name, "r");
-    if (!fp) {
-        fprintf(stderr, "Couldn't open file = %s\n", file_name);
-        exit(0);
-    }
-    fseek(fp, 0, SEEK_END);
-    size_t fsize = ftell(fp);
-    fseek(fp, 0, SEEK_SET);
-
-    string buf(fsize + 1, ' ');
-    buf.resize(fsize + 1);
-    auto read_bytes = fread(&buf[0], 1, fsize, fp);
-    assert(read_bytes == fsize);
-    fclose(fp);
-    return buf;
-}
-
-// token index in a list
-uint32_t token_index = 0;
+string_view Lexer::slice(uint32_t start) { return source.substr(start, index - start); }
 
-char Lexer::advance_char() {
-    location.column++;
-    return source[index++];
-}
-
-char Lexer::peek(uint32_t offset = 0) { return source[index + offset]; }
-bool Lexer::found_end() { return source[index] == '\0'; }
+// may look into the zero padding past the end of the source
+char Lexer::peek(uint32_t offset = 0) { return source.data()[index + offset]; }
+bool Lexer::found_end() { return index >= source.size(); }
 bool Lexer::match(char c) {
-    if (source[index] == c) {
+    if (peek() == c) {
         advance_char();
         return true;
     }
     return false;
 }
 void Lexer::scan_ident() {
-    auto start = location.start;
-    while (1) {
-        char c = peek();
-        switch (c) {
-        case 'a' ... 'z':
-        case 'A' ... 'Z':
-        case '0' ... '9':
-        case '_':
-            break;
-        default:
-            goto EXIT;
-        }
-        advance_char();
-    }
-EXIT:;
-    string buf = source.substr(start, index - start);
-    this->token = Token(Tok_Identifier, token_index++, this->location, buf);
-    switch (buf[0]) {
-#define StrSlice(S) #S, sizeof(#S)
-    case 'i': {
-        if (buf == "if") this->token = Token(Tok_Keyword_if, token_index++, this->location, buf);
-    } break;
-    case 'p': {
-        if (buf == "pub") this->token = Token(Tok_Keyword_pub, token_index++, this->location, buf);
-    } break;
-    case 'f': {
-        if (buf == "fn") this->token = Token(Tok_Keyword_fn, token_index++, this->location, buf);
-        if (buf == "for") this->token = Token(Tok_Keyword_for, token_index++, this->location, buf);
-    } break;
-    case 'c': {
-        if (buf == "const")
-            this->token = Token(Tok_Keyword_const, token_index++, this->location, buf);
-    } break;
-    case 'v': {
-        if (buf == "var") this->token = Token(Tok_Keyword_var, token_index++, this->location, buf);
-    } break;
-    case 'w': {
-        if (buf == "while")
-            this->token = Token(Tok_Keyword_while, token_index++, this->location, buf);
-    } break;
-    case 'r': {
-        if (buf == "return")
-            this->token = Token(Tok_Keyword_return, token_index++, this->location, buf);
-    } break;
-    default: {
-    } break;
+    auto start = token_start;
+    index = scan_kernels->skip_ident(source.data(), index, source.size());
+    // only non ASCII sources ever take this branch
+    while (peek() & 0x80) {
+        CodePoint cp = decode_utf8(source.data() + index);
+        if (!cp.len || !is_xid_continue(cp.value)) break;
+        index += cp.len;
+        index = scan_kernels->skip_ident(source.data(), index, source.size());
     }
+    string_view buf = slice(start);
+    this->token = Token(keyword_kind(buf), token_count++, buf);
+    if (token.kind == Tok_Identifier) literal = identifiers ? identifiers->intern(buf) : 0;
 }
+// index is just past the opening '"'. Escapes are checked even without a pool, so the
+// token kind is the same whether or not the literal gets decoded.
 void Lexer::scan_string_literal() {
-    auto start = location.start;
-
-    while (1) {
-        char c = peek();
-        switch (c) {
-        case '"':
-            advance_char();
-            goto EXIT;
-        default:
-            break;
+    auto start = token_start;
+    const char* src = source.data();
+    ByteOffset plain = index; // start of the text not copied to `escaped` yet
+    bool has_escapes = false;
+    bool valid = true;
+    if (strings) escaped.clear();
+    while (true) {
+        index = scan_kernels->find_string_end(src, index, source.size());
+        if (index >= source.size() || src[index] == '"') break;
+        // a '\': copy the plain span before it in one go, then decode the escape
+        if (strings) escaped.append(src + plain, index - plain);
+        uint32_t len = decode_escape(src + index, strings ? &escaped : nullptr);
+        if (!len) {
+            valid = false;
+            len = 2;
+        }
+        index = std::min<uint32_t>(index + len, source.size());
+        plain = index;
+        has_escapes = true;
+    }
+    ByteOffset body_end = index;
+    if (index < source.size()) advance_char(); // closing '"'
+
+    this->token = Token(valid ? Tok_StringLiteral : Tok_Invalid, token_count++, slice(start));
+    if (valid && strings) {
+        if (has_escapes) {
+            escaped.append(src + plain, body_end - plain);
+            literal = strings->intern(escaped);
+        } else {
+            literal = strings->intern(source.substr(start + 1, body_end - start - 1));
         }
-        c = advance_char();
     }
-EXIT:;
-
-    auto buf = source.substr(start, index - start);
-    this->token = Token(Tok_StringLiteral, token_index++, this->location, buf);
 }
 void Lexer::scan_number_literal() {
-    auto start = location.start;
-    while (1) {
-        char c = peek();
-        switch (c) {
-        case '0' ... '9':
-            break;
-        default:
-            goto EXIT;
-        }
-        advance_char();
+    auto start = token_start;
+    NumberParse num = parse_number(source.data() + start);
+    index = start + num.len;
+    literal = num.bits;
+
+    TokenKind kind = Tok_Invalid;
+    if (num.kind == Number_Int) kind = Tok_NumberLiteral;
+    if (num.kind == Number_Float) kind = Tok_FloatLiteral;
+    this->token = Token(kind, token_count++, slice(start));
+}
+// index is just past the first byte, the DFA looks at it again. A byte no operator starts
+// with (`'`, `\`, `%`, a stray '\r') is a one byte Tok_Invalid for the parser to report,
+// like a non ASCII one
+void Lexer::scan_operator() {
+    OperatorMatch op = match_operator(source.data() + token_start);
+    if (!op.len) {
+        this->token = Token(Tok_Invalid, token_count++, slice(token_start));
+        return;
     }
-EXIT:;
-    auto buf = source.substr(start, index - start);
-    this->token = Token(Tok_NumberLiteral, token_index++, this->location, buf);
+    index = token_start + op.len;
+    this->token = Token(op.kind, token_count++, slice(token_start));
 }
 void Lexer::scan_macro_or_preprocessor() {
     scan_ident();
@@ -149,32 +121,62 @@ void Lexer::scan_macro_or_preprocessor() {
 }
 
 void Lexer::skip_whitspaces() {
-    while (true) {
-        if (this->index >= source.size()) return;
-        char c = peek();
-        if (c == ' ' || c == '\t') {
-            this->location.column++;
-            c = advance_char();
-        } else if (c == '\n') {
-            this->location.line++;
-            this->location.column = 1;
-            c = advance_char();
-            this->location.line_start = index;
-        } else {
-            return;
+    // most tokens are separated by a single space or nothing at all,
+    // so only call into the kernels for real runs of whitespace
+    char c = peek();
+    if (c != ' ' && c != '\t' && c != '\n') return;
+    c = peek(1);
+    if (c != ' ' && c != '\t' && c != '\n') {
+        advance_char();
+        return;
+    }
+    // lines are not tracked here, see LineTable
+    this->index = scan_kernels->skip_whitespace(source.data(), index, source.size()).end;
+}
+
+// called with index on the leading '/', always consumes the whole comment
+void Lexer::skip_comment() {
+    ByteOffset start = index;
+    const char* src = source.data();
+    const char* end = src + source.size();
+    CommentKind kind;
+
+    if (peek(1) == '/') {
+        kind = peek(2) == '/' && peek(3) != '/' ? Comment_Doc : Comment_Line;
+        auto newline = (const char*)memchr(src + index + 2, '\n', end - (src + index + 2));
+        index = newline ? newline - src : source.size();
+    } else {
+        kind = peek(2) == '*' && peek(3) != '*' && peek(3) != '/' ? Comment_Doc : Comment_Block;
+        const char* p = src + index + 2;
+        while (true) {
+            p = (const char*)memchr(p, '*', end - p);
+            if (!p) {
+                index = source.size(); // unterminated, runs to the end
+                break;
+            }
+            if (p[1] == '/') {
+                index = p + 2 - src;
+                break;
+            }
+            p++;
         }
     }
+    if (comments) comments->add(start, index - start, kind);
 }
 
-void Lexer::reset_location_start() { this->location.start = this->index; }
+void Lexer::reset_location_start() { this->token_start = this->index; }
 
 // it doesn't return Token but it change lexer.token
 Token Lexer::next_token() {
     skip_whitspaces();
+    while (peek() == '/' && (peek(1) == '/' || peek(1) == '*')) {
+        skip_comment();
+        skip_whitspaces();
+    }
     reset_location_start();
 
     if (found_end()) {
-        token.set(Tok_Eof, location, "<EOF>");
+        token.set(Tok_Eof, "<EOF>");
         return token;
     }
 
@@ -198,119 +200,429 @@ Token Lexer::next_token() {
     case '#':
         scan_macro_or_preprocessor();
         break;
-    case '(':
-        token.set(Tok_LParen, location, "(");
+    case '\x80' ... '\xFF': {
+        // identifiers may start with any XID_Start character, anything else non ASCII
+        // becomes a Tok_Invalid for the parser to report
+        CodePoint cp = decode_utf8(source.data() + token_start);
+        index = token_start + (cp.len ? cp.len : 1);
+        if (cp.len && is_xid_start(cp.value)) {
+            scan_ident();
+        } else {
+            token = Token(Tok_Invalid, token_count++, slice(token_start));
+        }
         break;
+    }
 
-    case ')':
-        token.set(Tok_RParen, location, ")");
+    default:
+        scan_operator();
         break;
+    }
+    return token;
+}
 
-    case '{':
-        token.set(Tok_LBrace, location, "{");
-        break;
+auto Lexer::token_at(string_view source, ByteOffset start) -> Token {
+    Lexer lexer(source, start);
+    return lexer.next_token();
+}
 
-    case '}':
-        token.set(Tok_RBrace, location, "}");
-        break;
+// One newline aligned slice of the source, lexed as if no token crossed into it.
+// `resume` is the start of the first token at or after `end`, where the next chunk
+// should pick up if the guess was right. Names, strings and comments go to the chunk's
+// own tables, the start of what it lexed may be thrown away at the stitch.
+struct LexChunk {
+    ByteOffset begin;
+    ByteOffset end;
+    ByteOffset resume;
+    TokenList tokens;
+    Interner identifiers;
+    StringPool strings;
+    CommentTable comments;
+    // shared pool id of each local one that was kept, no_symbol until then
+    vector<SymbolId> identifier_ids;
+    vector<SymbolId> string_ids;
+};
+
+static void lex_chunk(string_view source, LexChunk& chunk) {
+    chunk.tokens.reserve((chunk.end - chunk.begin) / 4);
+    Lexer lexer(source, chunk.begin);
+    lexer.strings = &chunk.strings;
+    lexer.identifiers = &chunk.identifiers;
+    lexer.comments = &chunk.comments;
+    while (true) {
+        Token tok = lexer.next_token();
+        chunk.resume = lexer.offset();
+        if (tok.kind != Tok_Eof && lexer.offset() >= chunk.end) break;
+        chunk.tokens.push(tok.kind, lexer.offset());
+        if (has_literal_value(tok.kind)) chunk.tokens.push_literal(lexer.literal_value());
+        if (tok.kind == Tok_Eof) break;
+    }
+}
 
-    case '[':
-        token.set(Tok_LBracket, location, "[");
-        break;
+// the shared pool's id for the chunk's local `id`, interned the first time it's kept
+static auto shared_id(vector<SymbolId>& ids, const Interner& local, Interner& shared,
+                      uint64_t id) -> SymbolId {
+    if (id >= ids.size()) ids.resize(id + 1, no_symbol);
+    if (ids[id] == no_symbol) ids[id] = shared.intern(local.get(id));
+    return ids[id];
+}
 
-    case ']':
-        token.set(Tok_RBracket, location, "]");
-        break;
+// Appends chunk tokens starting at `from` and the comments from there on, returns true
+// once Eof was appended. Chunks are appended in file order, so the names and strings
+// reach the shared pools in the order tokenize() would have interned them, with the
+// same ids.
+static bool append_from(TokenList& out, CommentTable* comments, LexChunk& chunk,
+                        uint32_t from) {
+    const TokenList& tokens = chunk.tokens;
+    auto& owners = tokens.literal_tokens;
+    uint32_t first = std::lower_bound(owners.begin(), owners.end(), from) - owners.begin();
+    for (uint32_t i = first; i < owners.size(); i++) {
+        uint64_t value = tokens.literal_values[i];
+        TokenKind kind = tokens.kind(owners[i]);
+        if (kind == Tok_Identifier) {
+            value = shared_id(chunk.identifier_ids, chunk.identifiers, identifier_pool, value);
+        } else if (kind == Tok_StringLiteral) {
+            value = shared_id(chunk.string_ids, chunk.strings, string_pool, value);
+        }
+        out.literal_tokens.push_back(out.size() + (owners[i] - from));
+        out.literal_values.push_back(value);
+    }
+    if (comments) {
+        // the ones before the token at `from` were collected by whoever lexed that token.
+        // The first chunk has no tokens when a comment runs past its end.
+        const vector<Comment>& kept = chunk.comments.comments;
+        uint32_t at = from < tokens.size() ? chunk.comments.lower_bound(tokens.start(from)) : 0;
+        comments->comments.insert(comments->comments.end(), kept.begin() + at, kept.end());
+    }
+    out.kinds.insert(out.kinds.end(), tokens.kinds.begin() + from, tokens.kinds.end());
+    out.starts.insert(out.starts.end(), tokens.starts.begin() + from, tokens.starts.end());
+    return out.size() > 0 && out.kind(out.size() - 1) == Tok_Eof;
+}
 
-    case ';':
-        token.set(Tok_Semicolon, location, ";");
-        break;
+static auto find_start(const TokenList& tokens, ByteOffset start) -> uint32_t {
+    auto it = std::lower_bound(tokens.starts.begin(), tokens.starts.end(), start);
+    if (it == tokens.starts.end() || *it != start) return UINT32_MAX;
+    return it - tokens.starts.begin();
+}
 
-    case '&':
-        token.set(Tok_Ambersand, location, "&");
-        break;
+auto tokenize_parallel(string_view source, uint32_t jobs, CommentTable* comments,
+                       uint32_t min_chunk) -> TokenList {
+    if (jobs < 2 || source.size() < (uint64_t)min_chunk * 2) return tokenize(source, comments);
+    uint32_t count = std::min<uint32_t>(jobs, source.size() / min_chunk);
+
+    vector<LexChunk> chunks(count);
+    ByteOffset begin = 0;
+    for (uint32_t i = 0; i < count; i++) {
+        ByteOffset end = source.size();
+        if (i + 1 < count) {
+            end = std::max<ByteOffset>(begin, (uint64_t)source.size() * (i + 1) / count);
+            auto newline = source.find('\n', end);
+            end = newline == string_view::npos ? source.size() : newline + 1;
+        }
+        chunks[i].begin = begin;
+        chunks[i].end = end;
+        chunks[i].comments.mode = comments ? comments->mode : Comments_Skip;
+        begin = end;
+    }
 
-    case '~':
-        token.set(Tok_Tilde, location, "~");
-        break;
+    vector<std::thread> threads;
+    threads.reserve(count);
+    for (auto& chunk : chunks) {
+        threads.emplace_back(lex_chunk, source, std::ref(chunk));
+    }
+    for (auto& thread : threads) thread.join();
+
+    // Stitch the chunks together. The lexer carries no state besides its position, so
+    // once the previous chunk resumes on a token start the next chunk also produced,
+    // everything the next chunk lexed from there on is exact. If it never does (the
+    // chunk began inside a token, e.g. a multi line string, or inside a block comment,
+    // whose text it lexed as tokens and Tok_Invalid) relex from `resume` until the two
+    // streams meet again. What the chunk lexed before that is dropped.
+    TokenList out;
+    out.reserve(source.size() / 4);
+    if (append_from(out, comments, chunks[0], 0)) return out;
+    ByteOffset resume = chunks[0].resume;
+
+    for (uint32_t i = 1; i < count; i++) {
+        LexChunk& chunk = chunks[i];
+        uint32_t synced = find_start(chunk.tokens, resume);
+        if (synced != UINT32_MAX) {
+            if (append_from(out, comments, chunk, synced)) return out;
+            resume = chunk.resume;
+            continue;
+        }
 
-    case '.':
-        if (match('.')) token.set(Tok_DotDot, location, "..");
-        token.set(Tok_Dot, location, ".");
-        break;
+        Lexer lexer(source, resume);
+        lexer.strings = &string_pool;
+        lexer.identifiers = &identifier_pool;
+        lexer.comments = comments;
+        while (true) {
+            Token tok = lexer.next_token();
+            ByteOffset start = lexer.offset();
+            if (tok.kind != Tok_Eof && start >= chunk.end) {
+                resume = start;
+                break;
+            }
+            synced = find_start(chunk.tokens, start);
+            if (synced != UINT32_MAX) {
+                if (append_from(out, comments, chunk, synced)) return out;
+                resume = chunk.resume;
+                break;
+            }
+            out.push(tok.kind, start);
+            if (has_literal_value(tok.kind)) out.push_literal(lexer.literal_value());
+            if (tok.kind == Tok_Eof) return out;
+        }
+    }
+    return out;
+}
 
-    case ',':
-        token.set(Tok_Comma, location, ",");
-        break;
+auto tokenize(string_view source, CommentTable* comments) -> TokenList {
+    return tokenize(source, comments, &identifier_pool, &string_pool);
+}
 
-    case '?':
-        token.set(Tok_Questionmark, location, "?");
-        break;
+auto tokenize(string_view source, CommentTable* comments, Interner* identifiers,
+              StringPool* strings) -> TokenList {
+    TokenList tokens;
+    tokens.reserve(source.size() / 4);
+    Lexer lexer(source);
+    lexer.comments = comments;
+    lexer.strings = strings;
+    lexer.identifiers = identifiers;
+    while (true) {
+        Token tok = lexer.next_token();
+        tokens.push(tok.kind, lexer.offset());
+        if (has_literal_value(tok.kind)) tokens.push_literal(lexer.literal_value());
+        if (tok.kind == Tok_Eof) break;
+    }
+    return tokens;
+}
 
-    case ':':
-        token.set(Tok_Colon, location, ":");
-        break;
+// items [first, last) replaced by `with`, what follows is moved once if at all
+template <typename T>
+static void splice(vector<T>& items, uint32_t first, uint32_t last, const vector<T>& with) {
+    uint32_t count = with.size(), tail = items.size() - last;
+    if (count > last - first) items.resize(first + count + tail);
+    if (count != last - first)
+        memmove(items.data() + first + count, items.data() + last, tail * sizeof(T));
+    memcpy(items.data() + first, with.data(), count * sizeof(T));
+    if (count < last - first) items.resize(first + count + tail);
+}
 
-    case '^':
-        token.set(Tok_Caret, location, "^");
-        break;
+auto relex(TokenList& tokens, string_view source, const SourceEdit& edit) -> TokenEdit {
+    int32_t shift = (int32_t)edit.inserted.size() - (int32_t)edit.removed;
+    ByteOffset edit_end = edit.offset + edit.removed; // in the old text
 
-    case '!':
-        token.set(Tok_Bang, location, "!");
-        break;
+    // the last token starting before the edit may grow into it (`ab|` + `c`) and the
+    // one before that is kept as a safety margin, the lexer reads nothing before a token start
+    TokenIndex begin = std::max<int64_t>(0, (int64_t)tokens.first_at(edit.offset) - 2);
+    ByteOffset restart = begin == 0 ? 0 : tokens.start(begin);
 
-    case '=':
-        token.set(Tok_Equal, location, "=");
-        if (match('=')) token.set(Tok_EqualEqual, location, "==");
-        break;
-    case '+': {
-        token.set(Tok_Plus, location, "+");
-        if (match('+')) token.set(Tok_PlusPlus, location, "++");
-        if (match('=')) token.set(Tok_PlusEqual, location, "+=");
-        break;
+    // old tokens starting at or past the end of the edit see the same text as before,
+    // just shifted, so they're the candidates to resync on
+    TokenIndex old_index = tokens.first_at(edit_end);
+
+    TokenList relexed;
+    Lexer lexer(source, restart);
+    lexer.strings = &string_pool;
+    lexer.identifiers = &identifier_pool;
+    while (true) {
+        Token tok = lexer.next_token();
+        ByteOffset start = lexer.offset();
+        while (old_index < tokens.size() && (int64_t)tokens.start(old_index) + shift < start) {
+            old_index++;
+        }
+        if (old_index < tokens.size() && tokens.start(old_index) + shift == start) break;
+        relexed.push(tok.kind, start);
+        if (has_literal_value(tok.kind)) relexed.push_literal(lexer.literal_value());
+        if (tok.kind == Tok_Eof) {
+            old_index = tokens.size();
+            break;
+        }
     }
-    case '-':
-        token.set(Tok_Minus, location, "-");
-        if (match('-')) token.set(Tok_MinusMinus, location, "--");
-        if (match('=')) token.set(Tok_MinusEqual, location, "-=");
-        if (match('>')) token.set(Tok_Arrow, location, "->");
-        break;
 
-    case '*':
-        token.set(Tok_Asterisk, location, "*");
-        if (match('=')) token.set(Tok_AsteriskEqual, location, "*=");
-        break;
+    // with the same braces in the same order every block still ends where it did. The
+    // relexed tokens begin before the edit, often on the `{` of the block it is in.
+    auto is_brace = [](uint8_t kind) { return kind == Tok_LBrace || kind == Tok_RBrace; };
+    bool braces_changed = false;
+    for (TokenIndex i = begin, k = 0;; i++, k++) {
+        while (i < old_index && !is_brace(tokens.kinds[i])) i++;
+        while (k < relexed.size() && !is_brace(relexed.kinds[k])) k++;
+        if (i == old_index || k == relexed.size()) {
+            braces_changed = i != old_index || k != relexed.size();
+            break;
+        }
+        if (tokens.kinds[i] != relexed.kinds[k]) {
+            braces_changed = true;
+            break;
+        }
+    }
+    TokenEdit result = {begin, old_index - begin, relexed.size(), shift, braces_changed};
+
+    // Splice the relexed tokens in, the tail moving along as it is stored, with the shift
+    // it was owed from the last edit moved to where it begins first. That only goes over
+    // the tokens between the two edits, the tail then owes this edit's shift too. Same for
+    // the literals, whose owners after the edit owe the change in the token count.
+    uint32_t first = tokens.first_literal(begin);
+    uint32_t last = tokens.first_literal(old_index);
+    tokens.move_shift(old_index);
+    tokens.move_owner_shift(last);
+    for (auto& owner : relexed.literal_tokens) owner += begin;
+    splice(tokens.kinds, begin, old_index, relexed.kinds);
+    splice(tokens.starts, begin, old_index, relexed.starts);
+    splice(tokens.literal_tokens, first, last, relexed.literal_tokens);
+    splice(tokens.literal_values, first, last, relexed.literal_values);
+    tokens.shifted = begin + relexed.size();
+    tokens.shift += shift;
+    tokens.owners_shifted = first + relexed.literal_tokens.size();
+    tokens.owner_shift += (int32_t)relexed.size() - (int32_t)(old_index - begin);
+    return result;
+}
 
-    case '/':
-        token.set(Tok_Slash, location, "/");
-        if (match('/')) token.set(Tok_LineComment, location, "//");
-        if (match('=')) token.set(Tok_SlashEqual, location, "/=");
-        break;
+// closing and separating tokens, and the keywords of declarations, which are named
+// after their name. The parser makes nodes of the tokens that open something or stand
+// for something.
+static auto no_node_points_at(TokenKind kind) -> bool {
+    switch (kind) {
+    case Tok_Keyword_fn:
+    case Tok_Keyword_var:
+    case Tok_Keyword_const:
+    case Tok_Semicolon:
+    case Tok_Comma:
+    case Tok_Colon:
+    case Tok_Arrow:
+    case Tok_RParen:
+    case Tok_RBracket:
+    case Tok_RBrace:
+        return true;
+    default:
+        return false;
+    }
+}
 
-    case '<':
-        token.set(Tok_Less, location, "<");
-        if (match('=')) token.set(Tok_LessEqual, location, "<=");
-        if (match('<')) token.set(Tok_ShiftLeft, location, "<<");
-        break;
+static void released_token(TokenIndex i) {
+    fprintf(stderr, "token %u was already released from the stream window\n", i);
+    exit(1);
+}
 
-    case '>':
-        token.set(Tok_Greater, location, ">");
-        if (match('=')) token.set(Tok_GreaterEqual, location, ">=");
-        if (match('<')) token.set(Tok_ShiftRight, location, ">>");
-        break;
+auto TokenRing::start(TokenIndex i) -> ByteOffset {
+    if (i + capacity < lexed) {
+        auto it = std::lower_bound(kept_tokens.begin(), kept_tokens.end(), i);
+        if (it == kept_tokens.end() || *it != i) released_token(i);
+        return kept_starts[it - kept_tokens.begin()];
+    }
+    pull_until(i);
+    return starts[i & mask];
+}
 
-    case '|':
-        token.set(Tok_Pipe, location, "|");
-        if (match('|')) token.set(Tok_PipePipe, location, "||");
-        break;
+void TokenRing::pull_until(TokenIndex i) {
+    if (i + capacity < lexed) released_token(i);
+    while (lexed <= i) {
+        uint32_t slot = lexed & mask;
+        // the token `capacity` back leaves the window
+        if (lexed >= capacity && (pinned[slot] || !no_node_points_at((TokenKind)kinds[slot]))) {
+            kept_tokens.push_back(lexed - capacity);
+            kept_starts.push_back(starts[slot]);
+        }
+        pinned[slot] = false;
+        Token tok = lexer.next_token();
+        kinds[slot] = (uint8_t)tok.kind;
+        starts[slot] = lexer.offset();
+        if (has_literal_value(tok.kind)) literals[slot] = lexer.literal_value();
+        lexed++;
+    }
+}
 
-    default: {
-        fprintf(stderr, "Unhandled char [%c] at %s", c,
-                source.substr(index, source.size() - index).data());
-        exit(0);
+// what's stored past a pending shift can wrap around, the searches go by the real values
+auto TokenList::first_at(ByteOffset offset) const -> TokenIndex {
+    TokenIndex low = 0, high = size();
+    while (low < high) {
+        TokenIndex mid = low + (high - low) / 2;
+        if (start(mid) < offset) low = mid + 1;
+        else high = mid;
     }
+    return low;
+}
+
+auto TokenList::first_literal(TokenIndex i) const -> uint32_t {
+    uint32_t low = 0, high = literal_tokens.size();
+    while (low < high) {
+        uint32_t mid = low + (high - low) / 2;
+        if (literal_token(mid) < i) low = mid + 1;
+        else high = mid;
     }
-    return token;
+    return low;
+}
+
+auto TokenList::literal(TokenIndex i) const -> uint64_t {
+    uint32_t j = first_literal(i);
+    assert(j < literal_tokens.size() && literal_token(j) == i);
+    return literal_values[j];
+}
+
+auto TokenList::literal(TokenIndex i, uint32_t* hint) const -> uint64_t {
+    uint32_t h = *hint;
+    for (uint32_t next = h; next < h + 2 && next < literal_tokens.size(); next++) {
+        if (literal_token(next) == i) {
+            *hint = next;
+            return literal_values[next];
+        }
+    }
+    *hint = first_literal(i);
+    assert(*hint < literal_tokens.size() && literal_token(*hint) == i);
+    return literal_values[*hint];
+}
+
+void TokenList::move_shift(TokenIndex i) {
+    TokenIndex from = shift ? std::min(shifted, size()) : i;
+    for (TokenIndex k = from; k < i; k++) starts[k] += shift;
+    for (TokenIndex k = i; k < from; k++) starts[k] -= shift;
+    shifted = i;
+}
+
+void TokenList::move_owner_shift(uint32_t j) {
+    uint32_t from = owner_shift ? std::min<uint32_t>(owners_shifted, literal_tokens.size()) : j;
+    for (uint32_t k = from; k < j; k++) literal_tokens[k] += owner_shift;
+    for (uint32_t k = j; k < from; k++) literal_tokens[k] -= owner_shift;
+    owners_shifted = j;
+}
+
+auto CommentTable::lower_bound(ByteOffset offset) const -> uint32_t {
+    auto it = std::lower_bound(comments.begin(), comments.end(), offset,
+                               [](const Comment& c, ByteOffset offset) { return c.start < offset; });
+    return it - comments.begin();
+}
+
+auto CommentTable::doc_comments_before(string_view source, ByteOffset offset) const
+    -> std::pair<uint32_t, uint32_t> {
+    uint32_t last = lower_bound(offset);
+    uint32_t first = last;
+    ByteOffset gap_end = offset;
+    while (first > 0) {
+        const Comment& c = comments[first - 1];
+        if (c.kind != Comment_Doc) break;
+        auto gap = source.substr(c.start + c.len, gap_end - (c.start + c.len));
+        if (gap.find_first_not_of(" \t\n") != string_view::npos) break;
+        gap_end = c.start;
+        first--;
+    }
+    return {first, last};
+}
+
+void LineTable::build(string_view source) {
+    line_starts.clear();
+    line_starts.push_back(0);
+    const char* begin = source.data();
+    const char* end = begin + source.size();
+    for (const char* p = begin; (p = (const char*)memchr(p, '\n', end - p)); p++) {
+        line_starts.push_back(p - begin + 1);
+    }
+}
+
+auto LineTable::location_of(ByteOffset offset) const -> Location {
+    auto after = std::upper_bound(line_starts.begin(), line_starts.end(), offset);
+    uint32_t line = after - line_starts.begin();
+    ByteOffset line_start = line_starts[line - 1];
+    return Location(offset, line_start, line, offset - line_start + 1);
 }
 
 #define case_to_str(T)                                                                             \
@@ -324,6 +636,7 @@ auto enum_to_str(TokenKind kind) -> const char* {
         case_to_str(Tok_Identifier);
         case_to_str(Tok_StringLiteral);
         case_to_str(Tok_NumberLiteral);
+        case_to_str(Tok_FloatLiteral);
         case_to_str(Tok_CharLiteral);
         case_to_str(Tok_Include);
         case_to_str(Tok_Define);
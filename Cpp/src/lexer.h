@@ -1,14 +1,20 @@
 #pragma once
 #include "lib.h"
+#include "source.h"
+#include "string_pool.h"
 #include <stdint.h>
 #include <string.h>
 #include <string>
+#include <string_view>
 #include <vector>
 
 using string = std::string;
+using string_view = std::string_view;
 using std::vector;
 
-string read_file(const char* file_name);
+// printf helpers for non null-terminated token text
+#define SV_FMT "%.*s"
+#define SV_ARG(sv) (int)(sv).size(), (sv).data()
 
 enum TokenKind {
     Tok_Eof,
@@ -16,6 +22,7 @@ enum TokenKind {
     Tok_Identifier,
     Tok_StringLiteral,
     Tok_NumberLiteral,
+    Tok_FloatLiteral,
     Tok_CharLiteral,
     Tok_Include,
     Tok_Define,
@@ -110,82 +117,286 @@ struct Location {
     }
 };
 
+using TokenIndex = uint32_t;
+using ByteOffset = uint32_t;
+
+// A materialized token, only built when its text is needed (tree nodes, errors).
+// buf is a view into the lexer source (or a static string for Eof),
+// so copying a Token never allocates
 struct Token {
     TokenKind kind;
-    uint32_t index;
-    Location loc;
-    string buf;
-
-    ~Token() = default;
+    TokenIndex index;
+    string_view buf;
 
     Token() {}
 
-    Token(const Token& _token) {
-        this->kind = _token.kind;
-        this->index = _token.index;
-        this->loc = _token.loc;
-        this->buf = _token.buf;
+    Token(TokenKind _kind, TokenIndex _index, string_view _buf) : index(_index), buf(_buf) {
+        this->kind = _kind;
     }
 
-    Token(TokenKind _kind, uint32_t _index, Location& _loc, string _buf)
-        : index(_index), loc(_loc), buf(_buf) {
+    void set(TokenKind _kind, string_view _buf) {
         this->kind = _kind;
+        this->buf = _buf;
+        this->index = 0;
     }
+};
 
-    Token& operator=(const Token& _token) {
-        if (this != &_token) {
-            this->kind = _token.kind;
-            this->index = _token.index;
-            this->loc = _token.loc;
-            this->buf = _token.buf;
-        }
-        return *this;
+inline auto has_literal_value(TokenKind kind) -> bool {
+    return kind == Tok_NumberLiteral || kind == Tok_FloatLiteral || kind == Tok_StringLiteral ||
+           kind == Tok_Identifier;
+}
+
+// Token storage as parallel arrays, like Ast.TokenList in the zig port.
+// 5 bytes per token, the text and location are recomputed from `starts` on demand.
+// Literals are decoded and identifiers interned by the lexer, their values live in a
+// side array sorted by token index (12 more bytes per literal or identifier).
+//
+// relex() doesn't go over the tokens after an edit to move them along, it leaves what
+// they are owed here: the starts from token `shifted` on are `shift` bytes short, the
+// owners from literal `owners_shifted` on are `owner_shift` tokens short. The next edit
+// only settles the tokens between it and the one before, so typing in one place never
+// touches the rest of the file. start() and literal_token() add what's owed, code
+// reading the vectors directly has to settle() first.
+struct TokenList {
+    vector<uint8_t> kinds; // TokenKind
+    vector<ByteOffset> starts;
+    vector<TokenIndex> literal_tokens;
+    // integer, double bits for Tok_FloatLiteral, StringId for Tok_StringLiteral,
+    // SymbolId for Tok_Identifier
+    vector<uint64_t> literal_values;
+    TokenIndex shifted = UINT32_MAX;
+    int32_t shift = 0;
+    uint32_t owners_shifted = UINT32_MAX;
+    int32_t owner_shift = 0;
+
+    auto size() const -> uint32_t { return kinds.size(); }
+    auto kind(TokenIndex i) const -> TokenKind { return (TokenKind)kinds[i]; }
+    auto start(TokenIndex i) const -> ByteOffset {
+        return starts[i] + (i >= shifted ? shift : 0);
     }
+    // token of literal `j`
+    auto literal_token(uint32_t j) const -> TokenIndex {
+        return literal_tokens[j] + (j >= owners_shifted ? owner_shift : 0);
+    }
+    // first token starting at or past `offset`, and the first literal at or past token `i`
+    auto first_at(ByteOffset offset) const -> TokenIndex;
+    auto first_literal(TokenIndex i) const -> uint32_t;
+    // value of the literal at token `i`
+    auto literal(TokenIndex i) const -> uint64_t;
+    // same, starting from where the last lookup landed. Callers going through the
+    // tokens in order almost never need the binary search.
+    auto literal(TokenIndex i, uint32_t* hint) const -> uint64_t;
 
-    void set(TokenKind _kind, Location& _loc, string _buf) {
-        this->kind = _kind;
-        this->loc = _loc;
-        this->buf = _buf;
-        this->index = 0;
+    // moves what the starts are owed to begin at token `i`, or the owners at literal `j`,
+    // going over the tokens in between
+    void move_shift(TokenIndex i);
+    void move_owner_shift(uint32_t j);
+    // pays everything owed, the vectors hold the real starts and owners again
+    void settle() {
+        move_shift(size());
+        move_owner_shift(literal_tokens.size());
+        shifted = owners_shifted = UINT32_MAX;
+        shift = owner_shift = 0;
+    }
+
+    void reserve(uint32_t count) {
+        kinds.reserve(count);
+        starts.reserve(count);
+    }
+    void push(TokenKind kind, ByteOffset start) {
+        kinds.push_back((uint8_t)kind);
+        starts.push_back(start);
     }
+    // value of the token pushed last
+    void push_literal(uint64_t value) {
+        literal_tokens.push_back(size() - 1);
+        literal_values.push_back(value);
+    }
+};
+
+// Byte offset of every line start in a file, locations are looked up with a binary search
+struct LineTable {
+    vector<ByteOffset> line_starts;
+
+    LineTable() {}
+    LineTable(string_view source) { build(source); }
+
+    void build(string_view source);
+    auto is_built() const -> bool { return !line_starts.empty(); }
+    auto location_of(ByteOffset offset) const -> Location;
+};
+
+enum CommentKind : uint8_t {
+    Comment_Line,  // `// ...`
+    Comment_Block, // `/* ... */`
+    Comment_Doc,   // `/// ...` or `/** ... */`
+};
+
+// Comments never become tokens, the lexer skips them and can record them here,
+// sorted by offset, for tools (docs, formatter) to look up.
+struct Comment {
+    ByteOffset start;
+    uint32_t len;
+    CommentKind kind;
+};
+
+enum CommentMode {
+    Comments_Skip, // record nothing
+    Comments_Doc,  // record doc comments only
+    Comments_All,
+};
+
+struct CommentTable {
+    CommentMode mode = Comments_Doc;
+    vector<Comment> comments;
+
+    void add(ByteOffset start, uint32_t len, CommentKind kind) {
+        if (mode == Comments_All || (mode == Comments_Doc && kind == Comment_Doc))
+            comments.push_back({start, len, kind});
+    }
+
+    // index of the first comment starting at or after `offset`
+    auto lower_bound(ByteOffset offset) const -> uint32_t;
+    // the run of doc comments right before `offset` (only whitespace in between),
+    // as [first, last) indices into `comments`
+    auto doc_comments_before(string_view source, ByteOffset offset) const
+        -> std::pair<uint32_t, uint32_t>;
 };
 
 struct Lexer {
-     string& source;
+    // must be followed by source_padding zero bytes, see SourceBuffer
+    string_view source;
     ~Lexer() = default;
-    Lexer( string& _source) : source(_source) {
+    Lexer(string_view _source) : source(_source) {
         this->index = 0;
-        this->location = {0, 0, 1, 1};
+        this->token_start = 0;
     }
+    // starts lexing at `start`
+    Lexer(string_view _source, ByteOffset start) : Lexer(_source) { this->index = start; }
+
+    // where skipped comments go, nullptr drops them
+    CommentTable* comments = nullptr;
+    // where decoded string literals go, nullptr only checks their escapes
+    StringPool* strings = nullptr;
+    // where identifier names go, nullptr leaves their value at 0
+    Interner* identifiers = nullptr;
 
   private:
     uint32_t index;
-    Location location;
+    uint32_t token_count = 0;
+    ByteOffset token_start;
     Token token;
+    uint64_t literal = 0;
+    string escaped; // decoded text of the current string literal, if it has escapes
 
     char advance_char();
     char peek(uint32_t offset);
     bool found_end();
     bool match(char c);
+    string_view slice(uint32_t start);
     void scan_ident();
     void scan_string_literal();
     void scan_number_literal();
+    void scan_operator();
     void scan_macro_or_preprocessor();
 
     void skip_whitspaces();
+    void skip_comment();
     void reset_location_start();
     // it doesn't return Token but it change lexer.token
   public:
     Token next_token();
+    auto offset() const -> ByteOffset { return token_start; }
+    // decoded value of the last token, if it was a literal or an identifier
+    auto literal_value() const -> uint64_t { return literal; }
+
+    // re-lexes the token starting at `start` to recover its text
+    static auto token_at(string_view source, ByteOffset start) -> Token;
 
     static void print_token(Token& t) {
-        printf("{ %s | `%s`}\n", enum_to_str(t.kind), t.buf.data());
+        printf("{ %s | `" SV_FMT "`}\n", enum_to_str(t.kind), SV_ARG(t.buf));
     }
 
-    static void print_tokens(vector<Token>& tokens) {
-        for (int i = 0; i < tokens.size(); i++) {
-            Token token = tokens[i];
+    static void print_tokens(string_view source, TokenList& tokens) {
+        for (TokenIndex i = 0; i < tokens.size(); i++) {
+            Token token = Lexer::token_at(source, tokens.start(i));
             Lexer::print_token(token);
         }
     }
 };
+
+// lexes the whole source, the last token is always Tok_Eof
+auto tokenize(string_view source, CommentTable* comments = nullptr) -> TokenList;
+// same, with names and strings going to `identifiers` and `strings` rather than the
+// shared pools. With nullptr their values are left at 0, for tools that only need the
+// text and shouldn't fill the pools with every file they go through.
+auto tokenize(string_view source, CommentTable* comments, Interner* identifiers,
+              StringPool* strings) -> TokenList;
+
+// Same result as tokenize(), comments and interned ids included, but the source is split
+// at newlines into up to `jobs` chunks of at least `min_chunk` bytes that are lexed on
+// their own threads. The tests cut small files into chunks of a few bytes.
+constexpr uint32_t parallel_lex_min_chunk = 1 << 20;
+auto tokenize_parallel(string_view source, uint32_t jobs, CommentTable* comments = nullptr,
+                       uint32_t min_chunk = parallel_lex_min_chunk) -> TokenList;
+
+// Which tokens relex() replaced: `removed` old tokens starting at `begin` became
+// `inserted` new ones, tokens after them moved by `shift` bytes.
+struct TokenEdit {
+    TokenIndex begin;
+    uint32_t removed;
+    uint32_t inserted;
+    int32_t shift;
+    bool braces_changed; // a `{` or `}` among the removed or the inserted tokens
+};
+
+// Updates `tokens`, lexed from the text before `edit`, to match `source` (the text
+// after it). Lexing restarts a token before the edit and stops as soon as it lands
+// on the start of an old token past the edit, the rest is only shifted.
+auto relex(TokenList& tokens, string_view source, const SourceEdit& edit) -> TokenEdit;
+
+// Fixed size window over the token stream, tokens are pulled from the lexer as the
+// parser asks for them and overwritten once they fall `capacity` tokens behind.
+// Past the end the lexer keeps returning Tok_Eof.
+//
+// Of the tokens that left the window only the starts a node can point at are kept, for
+// printing the tree: all but the closing and separating punctuation (`;`, `)`, `->`...)
+// and the `fn`, `var` and `const` keywords, which no node has as its main token, unless
+// pin() asked for it. Their count grows with the tree, not with the file.
+struct TokenRing {
+    static constexpr uint32_t capacity = 64; // power of two
+    static constexpr uint32_t mask = capacity - 1;
+
+    Lexer lexer;
+    TokenIndex lexed = 0; // tokens pulled so far
+    uint8_t kinds[capacity];
+    ByteOffset starts[capacity];
+    uint64_t literals[capacity]; // only set for literals and identifiers
+    bool pinned[capacity] = {};
+    // the kept starts, by token index
+    vector<TokenIndex> kept_tokens;
+    vector<ByteOffset> kept_starts;
+
+    TokenRing(string_view source) : lexer(source) {
+        lexer.strings = &string_pool;
+        lexer.identifiers = &identifier_pool;
+    }
+
+    auto kind(TokenIndex i) -> TokenKind {
+        pull_until(i);
+        return (TokenKind)kinds[i & mask];
+    }
+    // also of the tokens that left the window, if their start was kept
+    auto start(TokenIndex i) -> ByteOffset;
+    auto literal(TokenIndex i) -> uint64_t {
+        pull_until(i);
+        return literals[i & mask];
+    }
+    // keep the start of `i`, still in the window, whatever its kind (an error points at it)
+    void pin(TokenIndex i) {
+        if (i < lexed && i + capacity >= lexed) pinned[i & mask] = true;
+    }
+
+  private:
+    void pull_until(TokenIndex i);
+};
@@ -1,22 +1,106 @@
+#include "ast_cache.h"
 #include "lexer.h"
+#include "out_buffer.h"
 #include "parser.h"
 #include <cstdio>
 #include <iostream>
+#include <string.h>
+#include <unistd.h>
 using namespace std;
 
+static void usage(const char* prog) {
+    fprintf(stdout, "Usage: \n");
+    fprintf(stdout, "\t%s [OPTIONS] <FILE_NAME>\n", prog);
+    fprintf(stdout, "Options: \n");
+    fprintf(stdout, "\t--stream        lex while parsing instead of lexing the whole file first\n");
+    fprintf(stdout, "\t--jobs <N>      lex and parse large files on N threads\n");
+    fprintf(stdout, "\t--signatures    skip function bodies, they print as LazyBody\n");
+    fprintf(stdout, "\t--cache <DIR>   keep parsed files in DIR, unchanged ones aren't parsed again\n");
+    fprintf(stdout, "\t--cache-size <MB>  most DIR may hold, the least recently used go first\n");
+    fprintf(stdout, "\t--max-errors <N> stop after N syntax errors (0, the default, reports all)\n");
+    fprintf(stdout, "\t--emit-ast=<FORMAT>  how to print the tree: tree (the default), json, sexpr\n");
+    fprintf(stdout, "Exit status: \n");
+    fprintf(stdout, "\t0 printed the tree, 1 syntax errors, 2 the file couldn't be read\n");
+    fprintf(stdout, "\tor isn't valid UTF-8\n");
+}
+
 int main(int argc, char** argv) {
-    if (argc < 2) {
-        fprintf(stdout, "Usage: \n");
-        fprintf(stdout, "\t%s <FILE_NAME>\n", argv[0]);
+    const char* file_name = nullptr;
+    ParseMode mode = Parse_Full;
+    uint32_t jobs = 1;
+    uint32_t max_errors = 0;
+    bool signatures = false;
+    EmitFormat format = Emit_Tree;
+    AstCache cache;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--stream") == 0) {
+            mode = Parse_Stream;
+        } else if (strcmp(argv[i], "--signatures") == 0) {
+            signatures = true;
+        } else if (strcmp(argv[i], "--jobs") == 0 && i + 1 < argc) {
+            jobs = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--cache") == 0 && i + 1 < argc) {
+            cache.dir = argv[++i];
+        } else if (strcmp(argv[i], "--cache-size") == 0 && i + 1 < argc) {
+            cache.max_bytes = (uint64_t)atoi(argv[++i]) << 20;
+        } else if (strcmp(argv[i], "--max-errors") == 0 && i + 1 < argc) {
+            max_errors = atoi(argv[++i]);
+        } else if (strncmp(argv[i], "--emit-ast=", 11) == 0) {
+            const char* name = argv[i] + 11;
+            if (strcmp(name, "tree") == 0) {
+                format = Emit_Tree;
+            } else if (strcmp(name, "json") == 0) {
+                format = Emit_Json;
+            } else if (strcmp(name, "sexpr") == 0) {
+                format = Emit_Sexpr;
+            } else {
+                usage(argv[0]);
+                exit(0);
+            }
+        } else if (argv[i][0] == '-' && argv[i][1] != '\0') {
+            usage(argv[0]);
+            exit(0);
+        } else {
+            file_name = argv[i];
+        }
+    }
+    if (!file_name) {
+        usage(argv[0]);
         exit(0);
     }
-    auto res = read_file(argv[1]);
+    std::string error;
+    auto source = read_file(file_name, &error);
+    if (!error.empty()) {
+        fprintf(stderr, "%s\n", error.c_str());
+        exit(2);
+    }
+
+    // the cache only holds complete trees of the whole file
+    bool use_cache = !cache.dir.empty() && mode == Parse_Full && !signatures;
+    TokenList cached_tokens;
+    CommentTable cached_comments; // or the ones tokenize_parallel() found
+    Ast cached_ast;
+    bool hit = use_cache && cache.load(source, &cached_tokens, &cached_comments, &cached_ast);
+    bool parallel = !hit && jobs > 1 && mode == Parse_Full;
 
-    Parser parser(res);
-    //parser.lexer.print_tokens(parser.tokens);
-	auto expr = parser.parseTopLevelStmts();
-    for (auto n : expr) {
-        n->print();
+    Parser parser = hit        ? Parser(source, static_cast<TokenList&&>(cached_tokens))
+                    : parallel ? Parser(source, tokenize_parallel(source, jobs, &cached_comments))
+                               : Parser(source, mode);
+    //Lexer::print_tokens(parser.source, parser.tokens);
+    if (hit || parallel) parser.comments = static_cast<CommentTable&&>(cached_comments);
+    if (hit) {
+        parser.ast = static_cast<Ast&&>(cached_ast);
+    } else {
+        parser.max_errors = max_errors;
+        parser.lazy_bodies = signatures;
+        parser.parseRootParallel(jobs);
+        if (parser.has_errors()) {
+            parser.printErrors();
+            exit(1);
+        }
+        if (use_cache) cache.store(source, parser.tokens, parser.comments, parser.ast);
     }
+    OutBuffer out(STDOUT_FILENO);
+    parser.emit_ast(out, format);
 
 }
@@ -0,0 +1,10 @@
+#pragma once
+#include "../../shared/number.h"
+#include <stdint.h>
+
+// parse_number() and NumberParse live in shared/number.h, the C frontend decodes
+// literals with the same code.
+
+inline auto bits_to_double(uint64_t bits) -> double { return num_bits_to_double(bits); }
+
+inline auto double_to_bits(double d) -> uint64_t { return num_double_to_bits(d); }
@@ -0,0 +1,189 @@
+#pragma once
+#include "lexer.h"
+#include <stdint.h>
+
+// Operators and punctuation are lexed with a DFA generated at compile time from
+// operator_list: one table walk per operator, always the longest match (`..` over `.`,
+// `>>=` would win over `>>` if it is ever added), and nothing else in the lexer needs
+// to know which operators exist.
+//
+// '#' is not here, it starts a preprocessor line (see scan_macro_or_preprocessor),
+// and comments are skipped before operators are looked at.
+
+struct Operator {
+    string_view text;
+    TokenKind kind;
+};
+
+constexpr Operator operator_list[] = {
+    {"=", Tok_Equal},
+    {"==", Tok_EqualEqual},
+    {"=>", Tok_EqualAngleBracketRt},
+    {"+", Tok_Plus},
+    {"++", Tok_PlusPlus},
+    {"+=", Tok_PlusEqual},
+    {"-", Tok_Minus},
+    {"--", Tok_MinusMinus},
+    {"-=", Tok_MinusEqual},
+    {"->", Tok_Arrow},
+    {"*", Tok_Asterisk},
+    {"*=", Tok_AsteriskEqual},
+    {"/", Tok_Slash},
+    {"/=", Tok_SlashEqual},
+    {"|", Tok_Pipe},
+    {"||", Tok_PipePipe},
+    {"&", Tok_Ambersand},
+    {"&&", Tok_Ambersand_Ambersand},
+    {"~", Tok_Tilde},
+    {"^", Tok_Caret},
+    {"!", Tok_Bang},
+    {"!=", Tok_BangEqual},
+    {"<", Tok_Less},
+    {"<=", Tok_LessEqual},
+    {"<<", Tok_ShiftLeft},
+    {">", Tok_Greater},
+    {">=", Tok_GreaterEqual},
+    {">>", Tok_ShiftRight},
+    {":", Tok_Colon},
+    {"::", Tok_ColonColon},
+    {":=", Tok_ColonEqual},
+    {".", Tok_Dot},
+    {"..", Tok_DotDot},
+    {",", Tok_Comma},
+    {";", Tok_Semicolon},
+    {"?", Tok_Questionmark},
+    {"@", Tok_AtSign},
+    {"$", Tok_DollarSign},
+    {"(", Tok_LParen},
+    {")", Tok_RParen},
+    {"{", Tok_LBrace},
+    {"}", Tok_RBrace},
+    {"[", Tok_LBracket},
+    {"]", Tok_RBracket},
+};
+
+// bytes are mapped to classes first so the transition table only has a column for
+// each byte some operator uses, class 0 is every other byte and never has a transition
+constexpr uint32_t operator_max_states = 64;
+constexpr uint32_t operator_max_classes = 32;
+
+struct OperatorDfa {
+    uint8_t classes[256];
+    // 0 is the start state, which is never a target, so 0 also means "no transition"
+    uint8_t next[operator_max_states][operator_max_classes];
+    uint8_t accept[operator_max_states]; // TokenKind ending in this state, or Tok_Invalid
+    uint32_t state_count = 1;
+    uint32_t class_count = 1;
+    bool is_valid = true; // false if it ran out of room or an operator is listed twice
+};
+
+// the trie of operator_list, which is already a DFA for a finite set of strings
+constexpr auto make_operator_dfa() -> OperatorDfa {
+    OperatorDfa dfa = {};
+    for (uint8_t& kind : dfa.accept) kind = Tok_Invalid;
+    for (const Operator& op : operator_list) {
+        for (char c : op.text) {
+            uint8_t& cls = dfa.classes[(uint8_t)c];
+            if (cls) continue;
+            if (dfa.class_count == operator_max_classes) {
+                dfa.is_valid = false;
+                return dfa;
+            }
+            cls = dfa.class_count++;
+        }
+    }
+    for (const Operator& op : operator_list) {
+        uint32_t state = 0;
+        for (char c : op.text) {
+            uint8_t& next = dfa.next[state][dfa.classes[(uint8_t)c]];
+            if (!next) {
+                if (dfa.state_count == operator_max_states) {
+                    dfa.is_valid = false;
+                    return dfa;
+                }
+                next = dfa.state_count++;
+            }
+            state = next;
+        }
+        if (op.text.empty() || dfa.accept[state] != Tok_Invalid) dfa.is_valid = false;
+        dfa.accept[state] = op.kind;
+    }
+    return dfa;
+}
+
+constexpr OperatorDfa operator_dfa = make_operator_dfa();
+static_assert(operator_dfa.is_valid, "operator_list doesn't fit the DFA or has duplicates");
+
+struct OperatorMatch {
+    TokenKind kind; // Tok_Invalid if no operator starts at `p`
+    uint32_t len;
+};
+
+// The longest operator starting at `p`. Stops at the first byte no operator continues
+// with, so a zero byte (the padding after the source) always ends the walk.
+constexpr auto match_operator(const char* p) -> OperatorMatch {
+    OperatorMatch best = {Tok_Invalid, 0};
+    uint32_t state = 0;
+    for (uint32_t i = 0;; i++) {
+        state = operator_dfa.next[state][operator_dfa.classes[(uint8_t)p[i]]];
+        if (!state) return best;
+        if (operator_dfa.accept[state] != Tok_Invalid)
+            best = {(TokenKind)operator_dfa.accept[state], i + 1};
+    }
+}
+
+// source text of an operator kind, empty for everything else
+constexpr auto operator_text(TokenKind kind) -> string_view {
+    for (const Operator& op : operator_list) {
+        if (op.kind == kind) return op.text;
+    }
+    return {};
+}
+
+//
+// Checked at compile time
+//
+
+// every punctuation kind in TokenKind (Tok_Equal .. Tok_ShiftLeft) is listed exactly once
+constexpr auto operators_cover_token_kinds() -> bool {
+    for (int kind = Tok_Equal; kind <= Tok_ShiftLeft; kind++) {
+        uint32_t count = 0;
+        for (const Operator& op : operator_list) count += op.kind == kind;
+        bool listed = kind != Tok_LineComment && kind != Tok_Hash;
+        if (count != (listed ? 1 : 0)) return false;
+    }
+    return true;
+}
+
+// kind -> text -> kind, alone and with each byte that could follow it in real code
+constexpr auto operators_round_trip() -> bool {
+    constexpr char followers[] = {'\0', ' ', 'a', '1', '(', '=', '.', '-', '>', ':'};
+    for (const Operator& op : operator_list) {
+        if (operator_text(op.kind) != op.text) return false;
+        for (char follower : followers) {
+            char buf[8] = {};
+            for (uint32_t i = 0; i < op.text.size(); i++) buf[i] = op.text[i];
+            buf[op.text.size()] = follower;
+            OperatorMatch m = match_operator(buf);
+            // the follower may only extend the match into another listed operator
+            string_view matched(buf, m.len);
+            if (m.len < op.text.size() || m.kind == Tok_Invalid) return false;
+            if (m.len == op.text.size() ? m.kind != op.kind : operator_text(m.kind) != matched)
+                return false;
+        }
+    }
+    return true;
+}
+
+static_assert(operators_cover_token_kinds(), "a punctuation TokenKind isn't in operator_list");
+static_assert(operators_round_trip(), "an operator doesn't lex back to its own kind");
+
+// the cases the old hand written chains got wrong
+static_assert(match_operator("..").kind == Tok_DotDot && match_operator("..").len == 2);
+static_assert(match_operator(">>").kind == Tok_ShiftRight);
+static_assert(match_operator("!=").kind == Tok_BangEqual);
+static_assert(match_operator("&&").kind == Tok_Ambersand_Ambersand);
+static_assert(match_operator("::").kind == Tok_ColonColon);
+static_assert(match_operator("+=1").kind == Tok_PlusEqual && match_operator("+=1").len == 2);
+static_assert(match_operator("-->").len == 2); // `--` `>`, not `-` `->`
+static_assert(match_operator("#").kind == Tok_Invalid && match_operator("#").len == 0);
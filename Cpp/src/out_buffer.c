@@ -0,0 +1,68 @@
+#include "out_buffer.h"
+#include <charconv>
+#include <errno.h>
+#include <unistd.h>
+
+void OutBuffer::put_uint(uint64_t value) {
+    char text[20];
+    auto end = std::to_chars(text, text + sizeof(text), value).ptr;
+    bytes.append(text, end - text);
+}
+
+void OutBuffer::put_double(double value) {
+    char text[32];
+    auto end = std::to_chars(text, text + sizeof(text), value).ptr;
+    bytes.append(text, end - text);
+}
+
+// quotes, backslashes and control characters escaped, everything else (UTF-8 included)
+// copied in runs
+void OutBuffer::put_json_string(std::string_view text) {
+    static const char hex[] = "0123456789abcdef";
+    bytes.push_back('"');
+    size_t run = 0;
+    for (size_t i = 0; i < text.size(); i++) {
+        unsigned char c = text[i];
+        if (c >= 0x20 && c != '"' && c != '\\') continue;
+        bytes.append(text.data() + run, i - run);
+        run = i + 1;
+        switch (c) {
+        case '"':
+            bytes.append("\\\"");
+            break;
+        case '\\':
+            bytes.append("\\\\");
+            break;
+        case '\n':
+            bytes.append("\\n");
+            break;
+        case '\t':
+            bytes.append("\\t");
+            break;
+        case '\r':
+            bytes.append("\\r");
+            break;
+        default: {
+            char escape[] = {'\\', 'u', '0', '0', hex[c >> 4], hex[c & 15]};
+            bytes.append(escape, sizeof(escape));
+        } break;
+        }
+    }
+    bytes.append(text.data() + run, text.size() - run);
+    bytes.push_back('"');
+}
+
+auto OutBuffer::flush() -> bool {
+    if (fd < 0) return true;
+    const char* p = bytes.data();
+    size_t left = bytes.size();
+    while (left > 0) {
+        ssize_t n = write(fd, p, left);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) break;
+        p += n;
+        left -= n;
+    }
+    bytes.clear();
+    return left == 0;
+}
@@ -0,0 +1,37 @@
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+#include <string>
+#include <string_view>
+
+// Text output gathered in memory and written to `fd` in chunks of about flush_size, so
+// dumping a whole tree takes a few write() calls rather than some stdio calls per node.
+// With fd -1 nothing is written and `bytes` ends up holding all of it.
+struct OutBuffer {
+    static constexpr size_t flush_size = 1 << 20;
+
+    int fd;
+    std::string bytes;
+
+    OutBuffer(int _fd = -1) : fd(_fd) {
+        if (fd >= 0) bytes.reserve(flush_size + flush_size / 4);
+    }
+    OutBuffer(const OutBuffer&) = delete;
+    ~OutBuffer() { flush(); }
+
+    void put(char c) { bytes.push_back(c); }
+    void put(std::string_view text) {
+        bytes.append(text);
+        if (bytes.size() >= flush_size) flush();
+    }
+    void put_spaces(uint32_t count) { bytes.append(count, ' '); }
+    void put_uint(uint64_t value);
+    // shortest text that reads back as the same double
+    void put_double(double value);
+    // `text` as a JSON string, quotes included
+    void put_json_string(std::string_view text);
+
+    // writes out what's buffered, if there's an fd. A failed write (a closed pipe) drops
+    // the output, there's nobody left to read it, and returns false.
+    auto flush() -> bool;
+};
@@ -0,0 +1,20 @@
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <stdint.h>
+#include <thread>
+#include <vector>
+
+// calls `work(i)` for every i < count, on `jobs` threads (this one included) that each
+// take the next i as soon as they're done with the last
+template <typename F> void for_each_parallel(uint32_t jobs, uint32_t count, F&& work) {
+    std::atomic<uint32_t> next = 0;
+    auto run = [&] {
+        for (uint32_t i; (i = next.fetch_add(1, std::memory_order_relaxed)) < count;) work(i);
+    };
+    std::vector<std::thread> threads;
+    threads.reserve(jobs - 1);
+    for (uint32_t i = 1; i < std::min(jobs, count); i++) threads.emplace_back(run);
+    run();
+    for (auto& thread : threads) thread.join();
+}
@@ -0,0 +1,184 @@
+#include "parallel.h"
+#include "parser.h"
+#include <algorithm>
+#include <memory>
+
+// Token index where each part starts, the last entry is the Eof token. A part ends right
+// before a `fn`, `var` or `const` outside of any braces that follows a `;` or `}`, once
+// it has at least `target` tokens.
+static auto split_parts(const TokenList& tokens, uint32_t target) -> vector<TokenIndex> {
+    vector<TokenIndex> cuts = {0};
+    TokenIndex eof = tokens.size() - 1;
+    uint32_t depth = 0;
+    for (TokenIndex i = 0; i < eof; i++) {
+        switch (tokens.kind(i)) {
+        case Tok_LBrace:
+            depth++;
+            break;
+        case Tok_RBrace:
+            // a stray `}` is a syntax error, the parts find it
+            if (depth > 0) depth--;
+            break;
+        case Tok_Keyword_fn:
+        case Tok_Keyword_var:
+        case Tok_Keyword_const: {
+            if (depth > 0 || i - cuts.back() < target) break;
+            TokenKind prev = tokens.kind(i - 1);
+            if (prev == Tok_Semicolon || prev == Tok_RBrace) cuts.push_back(i);
+        } break;
+        default:
+            break;
+        }
+    }
+    cuts.push_back(eof);
+    return cuts;
+}
+
+// tokens [begin, end) with an Eof after them, so a Parser sees them as a whole file
+static auto slice_tokens(const TokenList& tokens, TokenIndex begin, TokenIndex end) -> TokenList {
+    TokenList part;
+    part.kinds.reserve(end - begin + 1);
+    part.starts.reserve(end - begin + 1);
+    part.kinds.assign(tokens.kinds.begin() + begin, tokens.kinds.begin() + end);
+    part.starts.assign(tokens.starts.begin() + begin, tokens.starts.begin() + end);
+    part.push(Tok_Eof, tokens.start(end));
+    auto& owners = tokens.literal_tokens;
+    uint32_t first = std::lower_bound(owners.begin(), owners.end(), begin) - owners.begin();
+    uint32_t last = std::lower_bound(owners.begin() + first, owners.end(), end) - owners.begin();
+    part.literal_tokens.reserve(last - first);
+    for (uint32_t i = first; i < last; i++) part.literal_tokens.push_back(owners[i] - begin);
+    part.literal_values.assign(tokens.literal_values.begin() + first,
+                               tokens.literal_values.begin() + last);
+    return part;
+}
+
+// Copies the nodes of `part` but its root to `ast` from `node_base` on, and its
+// extra_data but the root's list from `extra_base` on, moving every node, extra and
+// token index along. Needs to know the same per tag layout as for_each_child().
+static void copy_part(Ast& ast, const Ast& part, NodeIndex node_base, uint32_t extra_base,
+                      TokenIndex token_base) {
+    uint32_t node_shift = node_base - 1;
+    auto node = [&](NodeIndex n) -> NodeIndex { return n ? n + node_shift : 0; };
+    uint32_t* extra = ast.extra_data.data() + extra_base;
+    // the root's list is the last thing added
+    memcpy(extra, part.extra_data.data(), part.data(0).lhs * 4);
+    auto move_list = [&](SubRange range) {
+        for (uint32_t i = range.start; i < range.end; i++) extra[i] = node(extra[i]);
+        return SubRange{range.start + extra_base, range.end + extra_base};
+    };
+
+    for (NodeIndex i = 1; i < part.size(); i++) {
+        NodeData data = part.data(i);
+        switch (part.tag(i)) {
+        case Ast_Identifier:
+        case Ast_StringLiteral:
+        case Ast_NumberLiteral:
+        case Ast_FloatLiteral:
+        case Ast_Bool_Not:
+        case Ast_Negation:
+        case Ast_Bit_Not:
+        case Ast_AddressOf:
+        case Ast_Error:
+        case Ast_LazyBody:
+            break;
+        case Ast_Pointer:
+        case Ast_ParamDecl:
+            data.lhs = node(data.lhs);
+            break;
+        case Ast_ParamDeclList:
+        case Ast_Block: {
+            SubRange list = move_list({data.lhs, data.rhs});
+            data = {list.start, list.end};
+        } break;
+        case Ast_Call: {
+            SubRange args = move_list(part.extra<SubRange>(data.rhs));
+            memcpy(extra + data.rhs, &args, sizeof(args));
+            data.rhs += extra_base;
+        } break;
+        case Ast_FnDecl: {
+            FnProto proto = part.extra<FnProto>(data.lhs);
+            proto.params = node(proto.params);
+            proto.return_type = node(proto.return_type);
+            memcpy(extra + data.lhs, &proto, sizeof(proto));
+            data = {data.lhs + extra_base, node(data.rhs)};
+        } break;
+        case Ast_VarDecl:
+        case Ast_ConstDecl: {
+            VarDeclInfo info = part.extra<VarDeclInfo>(data.lhs);
+            info.type = node(info.type);
+            info.value = node(info.value);
+            memcpy(extra + data.lhs, &info, sizeof(info));
+            data.lhs += extra_base;
+        } break;
+        default:
+            // binary operators, Assign, FieldAccess, Array, If_Simple, SimpleLoop
+            data = {node(data.lhs), node(data.rhs)};
+            break;
+        }
+        NodeIndex to = i + node_shift;
+        ast.tags[to] = part.tags[i];
+        ast.main_tokens[to] = part.main_tokens[i] + token_base;
+        ast.datas[to] = data;
+    }
+}
+
+// The parts are parsed into an Ast each and copied into `ast` in source order. Each part
+// starts with a fresh root and ends with its root's list, and the parser has nothing
+// else on its stacks between top level statements, so the copy comes out the same as
+// what parseRoot() builds, index for index.
+auto Parser::parseRootParallel(uint32_t jobs) -> void {
+    if (stream || jobs < 2 || tokens.size() < parallel_parse_min_tokens * 2) return parseRoot();
+    tokens.settle(); // the parts are sliced out of the vectors
+    uint32_t target = std::max(parallel_parse_min_tokens, tokens.size() / (jobs * 4));
+    vector<TokenIndex> cuts = split_parts(tokens, target);
+    uint32_t count = cuts.size() - 1;
+    if (count < 2) return parseRoot();
+
+    vector<std::unique_ptr<Parser>> parts(count);
+    for_each_parallel(jobs, count, [&](uint32_t i) {
+        parts[i] = std::make_unique<Parser>(source, slice_tokens(tokens, cuts[i], cuts[i + 1]));
+        parts[i]->lazy_bodies = lazy_bodies;
+        parts[i]->parseRoot();
+    });
+    // errors near a cut would be reported and recovered from differently, and files with
+    // errors are rare, so those are parsed again in one go
+    for (auto& part : parts) {
+        if (part->has_errors()) return parseRoot();
+    }
+
+    vector<NodeIndex> node_base(count);
+    vector<uint32_t> extra_base(count), stmt_base(count);
+    uint32_t nodes = 1, extras = 0, stmts = 0;
+    for (uint32_t i = 0; i < count; i++) {
+        const Ast& part = parts[i]->ast;
+        node_base[i] = nodes;
+        extra_base[i] = extras;
+        stmt_base[i] = stmts;
+        nodes += part.size() - 1;
+        extras += part.data(0).lhs;
+        stmts += part.data(0).rhs - part.data(0).lhs;
+    }
+    ast.clear();
+    ast.tags.resize(nodes);
+    ast.main_tokens.resize(nodes);
+    ast.datas.resize(nodes);
+    ast.extra_data.resize(extras + stmts);
+    ast.tags[0] = Ast_Root;
+    ast.main_tokens[0] = 0;
+    ast.datas[0] = {extras, extras + stmts};
+    root_starts.resize(stmts);
+    root_errors.assign(stmts, 0);
+
+    for_each_parallel(jobs, count, [&](uint32_t i) {
+        const Ast& part = parts[i]->ast;
+        copy_part(ast, part, node_base[i], extra_base[i], cuts[i]);
+        uint32_t* root_list = ast.extra_data.data() + extras + stmt_base[i];
+        for (NodeIndex stmt : part.list(0)) *root_list++ = stmt ? stmt + node_base[i] - 1 : 0;
+        for (uint32_t k = 0; k < parts[i]->root_starts.size(); k++)
+            root_starts[stmt_base[i] + k] = parts[i]->root_starts[k] + cuts[i];
+        parts[i].reset();
+    });
+    parsed_size = nodes + ast.extra_data.size();
+    index = tokens.size() - 1;
+    current = Tok_Eof;
+}
@@ -15,67 +15,156 @@ auto enum_to_str(ErrorKind kind) -> const char* {
         case_to_str(error_expected_type_expr);
         case_to_str(error_expected_var_decl);
         case_to_str(error_expected_fnuction_call);
+        case_to_str(error_expected_token);
+        case_to_str(error_expected_statement);
     }
     return "";
 }
 
-auto Parser::next_token() -> Token {
-    Token tok = current;
-    current = tokens[++index];
+// stays on Eof, error recovery may ask for more tokens than there are
+auto Parser::next_token() -> TokenIndex {
+    TokenIndex tok = index;
+    if (current != Tok_Eof) current = kind_at(++index);
     return tok;
 }
 
-auto Parser::get_line_of(Token token) -> string {
-    return source.substr(token.loc.line_start,
-                         source.find("\n", token.loc.line_start) - token.loc.line_start);
+auto Parser::token_at(TokenIndex i) -> Token {
+    Token tok = Lexer::token_at(source, start_at(i));
+    tok.index = i;
+    return tok;
 }
 
-auto Parser::expectToken(TokenKind kind) -> Token {
-    if (current.kind != kind) {
-        fprintf(stderr, "expected token %s but found { %s: %s } \n", enum_to_str(kind),
-                enum_to_str(current.kind), current.buf.c_str());
-        fprintf(stderr, Color_Bright_red "error line =>  %s" Color_Reset "\n",
-                get_line_of(current).c_str());
-        exit(1); // Fatal error, exit
+auto Parser::location_of(TokenIndex i) -> Location {
+    if (!lines.is_built()) lines.build(source);
+    return lines.location_of(start_at(i));
+}
+
+auto Parser::get_line_of(TokenIndex i) -> string {
+    auto line_start = location_of(i).line_start;
+    return string(source.substr(line_start, source.find("\n", line_start) - line_start));
+}
+
+// a missing token is reported and not consumed, the returned index is then the token
+// found in its place
+auto Parser::expectToken(TokenKind kind, const char* caller) -> TokenIndex {
+    if (current != kind) {
+        fail(error_expected_token, "", index, kind, caller);
+        return index;
     }
     return next_token();
 }
 
-auto Parser::parsePrimaryExpr() -> Expr* {
-    switch (current.kind) {
-    case Tok_Identifier: {
-        Token ident = next_token();
-        Literal* ident_literal = new Literal(Ast_Identifier, ident);
-        switch (current.kind) {
-        case Tok_Dot: {
-            Token dot = next_token();
-            BinaryExpr* expr = new BinaryExpr(Ast_FieldAccess, dot, ident_literal, nullptr);
-            expr->rhs = parsePrimaryExpr();
-            return expr;
-        }
-        case Tok_LParen: {
-            next_token();
-        } break;
-        default: {
-            return ident_literal;
+auto Parser::printErrors() -> void {
+    for (const auto& error : errors) {
+        auto loc = location_of(error.token);
+        Token tok = token_at(error.token);
+        fprintf(stderr, "[ParsingError]: %s at [%d,%d] { %s : `" SV_FMT "` }\n",
+                enum_to_str(error.kind), loc.line, loc.column, enum_to_str(tok.kind),
+                SV_ARG(tok.buf));
+        if (error.kind == error_expected_token) {
+            fprintf(stderr, "Message: expected %s\n", enum_to_str(error.expected));
+        } else {
+            fprintf(stderr, "Message: %s\n", error.msg);
         }
+        fprintf(stderr, Color_Bright_red "error line =>  %s" Color_Reset "\n",
+                get_line_of(error.token).c_str());
+    }
+    if (gave_up()) fprintf(stderr, "stopped after %u errors (--max-errors)\n", max_errors);
+}
+
+// Panic mode recovery, called after a statement that failed. Skips to where the next
+// statement can start: after a `;`, at a statement keyword, or at the `}` that ends the
+// current block (a stray `}` at the top level is skipped). Anything in braces is skipped
+// as a whole.
+auto Parser::synchronize(bool top_level) -> void {
+    panicking = false;
+    // the failed statement still ended properly
+    if (index > 0 && (kind_at(index - 1) == Tok_Semicolon || kind_at(index - 1) == Tok_RBrace))
+        return;
+    uint32_t depth = 0;
+    while (current != Tok_Eof) {
+        switch (current) {
+        case Tok_LBrace:
+            depth++;
+            break;
+        case Tok_RBrace:
+            if (depth == 0 && !top_level) return;
+            if (depth > 0) depth--;
+            break;
+        case Tok_Semicolon:
+            if (depth == 0) {
+                next_token();
+                return;
+            }
+            break;
+        case Tok_Keyword_fn:
+        case Tok_Keyword_var:
+        case Tok_Keyword_const:
+        case Tok_Keyword_if:
+        case Tok_Keyword_for:
+        case Tok_Keyword_while:
+            if (depth == 0) return;
+            break;
+        default:
+            break;
         }
-    } break;
-    case Tok_NumberLiteral: {
-        Literal* lit = new Literal(Ast_NumberLiteral, current);
         next_token();
-        return lit;
+    }
+}
+
+// `a.b.c` nests to the right: the names go on `scratch` and the dots on `operators`
+// until the chain ends, then the FieldAccess nodes are made from the end back
+auto Parser::parsePrimaryExpr() -> NodeIndex {
+    size_t base = operators.size();
+    NodeIndex result = 0;
+    while (true) {
+        if (current != Tok_Identifier) {
+            result = parseLiteral();
+            if (!result && operators.size() > base) {
+                fail(error_expected_expression, "expected a name after the `.`", index);
+                result = error_node(index);
+            }
+            break;
+        }
+        TokenIndex ident = next_token();
+        NodeIndex ident_node = ast.add_node(Ast_Identifier, ident, {symbol_at(ident), 0});
+        if (current == Tok_Dot) {
+            scratch.push_back(ident_node);
+            operators.push_back({next_token(), Ast_FieldAccess, 0});
+            continue;
+        }
+        if (current == Tok_LParen) {
+            next_token();
+            result = 0;
+        } else {
+            result = ident_node;
+        }
+        break;
+    }
+    while (operators.size() > base) {
+        result = ast.add_node(Ast_FieldAccess, operators.back().token, {scratch.back(), result});
+        operators.pop_back();
+        scratch.pop_back();
+    }
+    return result;
+}
+
+auto Parser::parseLiteral() -> NodeIndex {
+    switch (current) {
+    case Tok_NumberLiteral:
+    case Tok_FloatLiteral: {
+        NodeKind tag = current == Tok_FloatLiteral ? Ast_FloatLiteral : Ast_NumberLiteral;
+        uint64_t value = literal_at(index);
+        return ast.add_node(tag, next_token(), {(uint32_t)value, (uint32_t)(value >> 32)});
     } break;
     case Tok_StringLiteral: {
-        Literal* lit = new Literal(Ast_StringLiteral, current);
-        next_token();
-        return lit;
+        StringId id = (StringId)literal_at(index);
+        return ast.add_node(Ast_StringLiteral, next_token(), {id, 0});
     } break;
     default: {
-        return nullptr;
+        return 0;
     }
     }
-    return nullptr;
 }
 
 struct OpInfo {
@@ -120,9 +209,9 @@ static inline auto get_binary_op_info(TokenKind kind) -> OpInfo {
     }
 }
 
-auto Parser::parsePrefixExpr() -> Expr* {
+auto Parser::parsePrefixExpr() -> NodeIndex {
     NodeKind tag;
-    switch (current.kind) {
+    switch (current) {
     case Tok_Bang:
         tag = Ast_Bool_Not;
         next_token();
@@ -142,252 +231,286 @@ auto Parser::parsePrefixExpr() -> Expr* {
     default:
         return parsePrimaryExpr();
     }
-    Token op = next_token();
-    return new Literal(tag, op);
+    // the operand is the one token after the operator
+    if (current != Tok_Identifier && current != Tok_NumberLiteral &&
+        current != Tok_FloatLiteral && current != Tok_StringLiteral) {
+        fail(error_expected_expression, "expected an operand after the operator", index);
+        return error_node(index);
+    }
+    return ast.add_node(tag, next_token(), {0, 0});
 }
 
-auto Parser::parsePrecedenceExpr(int min) -> Expr* {
-    Expr* left = parsePrefixExpr();
-    if (!left) return nullptr;
+// Operator precedence without recursion: operands wait on `scratch` and operators on
+// `operators` until an operator that binds less tightly comes along. Operators of the
+// same precedence group to the right, `a - b - c` is `a - (b - c)`.
+auto Parser::parsePrecedenceExpr(int min) -> NodeIndex {
+    NodeIndex left = parsePrefixExpr();
+    if (!left) return 0;
+    size_t base = operators.size();
+    size_t operands = scratch.size();
+    scratch.push_back(left);
+
+    // the top operator and its two operands become one operand
+    auto reduce = [&] {
+        PendingOp op = operators.back();
+        operators.pop_back();
+        NodeIndex rhs = scratch.back();
+        scratch.pop_back();
+        scratch.back() = ast.add_node(op.tag, op.token, {scratch.back(), rhs});
+    };
 
     while (true) {
-        auto op_info = get_binary_op_info(current.kind);
+        auto op_info = get_binary_op_info(current);
         if (op_info.prec < min) break;
+        while (operators.size() > base && operators.back().prec > op_info.prec) reduce();
 
-        if (op_info.prec == -1) {
-            printf("[ParsingError]: Chained comparison operator!!\n");
-        }
         auto op_token = next_token();
-
-        Expr* right = parsePrecedenceExpr(op_info.prec);
+        NodeIndex right = parsePrefixExpr();
         if (!right) {
-            fprintf(stderr, "[ParsingError]: expected primary expression but found -> %s\n",
-                    tokens[op_token.index + 1].buf.c_str());
-
-            exit(1); // Fatal error, exit
-                     //  return nullptr;
+            fail(error_expected_expression, "expected an operand after the operator", index);
+            operators.push_back({op_token, op_info.tag, op_info.prec});
+            scratch.push_back(error_node(index));
+            break;
         }
-        left = new BinaryExpr(op_info.tag, op_token, left, right);
+        operators.push_back({op_token, op_info.tag, op_info.prec});
+        scratch.push_back(right);
     }
+    while (operators.size() > base) reduce();
+    left = scratch.back();
+    scratch.resize(operands);
     return left;
 }
 
-auto Parser::parseExpr() -> Expr* { return parsePrecedenceExpr(0); }
+auto Parser::parseExpr() -> NodeIndex { return parsePrecedenceExpr(0); }
 
-auto Parser::expectExpr() -> Expr* {
+auto Parser::expectExpr() -> NodeIndex {
     auto expr = parseExpr();
-    if (expr == nullptr) {
-        fail(error_expected_expression, "<Expr>", current);
+    if (expr == 0) {
+        fail(error_expected_expression, "expected an expression", index);
     }
     return expr;
 }
 
-auto is_assignable(Expr* expr) -> bool { return true; }
+auto is_assignable(const Ast& ast, NodeIndex expr) -> bool { return true; }
 
-auto Parser::parseAssignExpr() -> Expr* {
-    auto id = parseExpr();
-    if (!is_assignable(id)) {
-        fprintf(stderr,
-                Color_Red "[ParsingError]:" Color_Reset "you can't assign to this expressiong ");
-        fprintf(stderr, "%s", enum_to_str(id->kind));
-        exit(1); // Fatal error, exit
+auto Parser::parseAssignExpr() -> NodeIndex {
+    auto id = expectExpr();
+    if (!is_assignable(ast, id)) {
+        fail(error_unexpected_token, "you can't assign to this expression", index);
     }
 
     auto eql_op = expectToken(Tok_Equal);
-    auto val = parseExpr();
-    return new BinaryExpr(Ast_Assign, eql_op, id, val);
+    auto val = expectExpr();
+    return ast.add_node(Ast_Assign, eql_op, {id, val});
 }
 
-auto Parser::parseTypeExpr() -> Type* {
-    switch (current.kind) {
-    case Tok_Identifier: {
-        Token id = next_token();
-        return new Type(Ast_Identifier, id);
-    }
-    case Tok_Asterisk: {
-        Token astr = next_token();
-        Type* base = parseTypeExpr();
-        return new Pointer(base, astr);
-    }
-    case Tok_LBracket: {
-        auto l_brace = next_token();
-        Token tok_rep = l_brace;
-        auto len_expr = parseExpr();
-        if (len_expr == nullptr) {
-            tok_rep.buf += "]";
+// `*` and `[len]` prefixes are added with their base left 0 and filled in once the name
+// at the end is reached, so `****T` doesn't recurse either
+auto Parser::parseTypeExpr() -> NodeIndex {
+    size_t top = scratch.size();
+    NodeIndex base = 0;
+    while (!base) {
+        switch (current) {
+        case Tok_Identifier: {
+            TokenIndex name = next_token();
+            base = ast.add_node(Ast_Identifier, name, {symbol_at(name), 0});
+        } break;
+        case Tok_Asterisk: {
+            auto astr = next_token();
+            scratch.push_back(ast.add_node(Ast_Pointer, astr, {0, 0}));
+        } break;
+        case Tok_LBracket: {
+            auto l_brace = next_token();
+            auto len_expr = parseExpr();
+            expectToken(Tok_RBracket);
+            scratch.push_back(ast.add_node(Ast_Array, l_brace, {len_expr, 0}));
+        } break;
+        default: {
+            fail(error_expected_type_expr, "expected a type", index);
+            base = error_node(index);
+        } break;
         }
-        expectToken(Tok_RBracket);
-        Type* base = parseTypeExpr();
-        return new Array(base, len_expr, l_brace);
-    }
-    default: {
-        fprintf(stderr, "[ParsingError]: expected type expression ");
-        fprintf(stderr, "but found %s\n", enum_to_str(current.kind));
-        exit(0);
     }
+    while (scratch.size() > top) {
+        NodeIndex prefix = scratch.back();
+        scratch.pop_back();
+        if (ast.tag(prefix) == Ast_Pointer) {
+            ast.datas[prefix].lhs = base;
+        } else {
+            ast.datas[prefix].rhs = base;
+        }
+        base = prefix;
     }
-    return nullptr;
+    return base;
 }
 
 // Call( name: str, id : int)
-auto Parser::parseParamDecl() -> Decl* {
+auto Parser::parseParamDecl() -> NodeIndex {
     const auto id = expectToken(Tok_Identifier);
+    const SymbolId name = symbol_at(id);
     expectToken(Tok_Colon);
     const auto type = parseTypeExpr();
-    return new ParamDecl(id, type);
+    return ast.add_node(Ast_ParamDecl, id, {type, name});
 }
 
-auto Parser::parseFnDeclParams() -> ParamList* {
-    auto l_paren = next_token();
-    vector<Decl*> list;
-    list.reserve(3);
+auto Parser::parseFnDeclParams() -> NodeIndex {
+    auto l_paren = expectToken(Tok_LParen);
+    size_t top = scratch.size();
 
-    while (true) {
-        if (current.kind == Tok_RParen) {
-            next_token();
-            break;
-        }
+    while (!panicking && current != Tok_RParen && current != Tok_Eof) {
         auto param = parseParamDecl();
-        list.push_back(param);
-
-        if (current.kind == Tok_RParen) {
-            next_token();
-            break;
-        }
-        if (current.kind == Tok_Comma) next_token();
+        scratch.push_back(param);
+        if (current == Tok_Comma) next_token();
     }
-    return new ParamList(list);
+    expectToken(Tok_RParen);
+    SubRange params = pop_list(top);
+    return ast.add_node(Ast_ParamDeclList, l_paren, {params.start, params.end});
 }
-auto Parser::parseFnCall() -> Expr* {
+auto Parser::parseFnCall() -> NodeIndex {
     auto fn_name = next_token();
+    // read now, in Parse_Stream mode the name may be out of the window after the arguments
+    SymbolId symbol = symbol_at(fn_name);
     auto l_paren = expectToken(Tok_LParen);
-    vector<Expr*> list;
-    list.reserve(3);
+    size_t top = scratch.size();
 
-    while (true) {
-        if (current.kind == Tok_RParen) {
-            next_token();
-            break;
-        }
+    while (!panicking && current != Tok_RParen && current != Tok_Eof) {
         auto param = parseExpr();
-        list.push_back(param);
-        if (current.kind == Tok_RParen) {
-            next_token();
-            break;
+        if (!param) {
+            // nothing was consumed, stop here rather than ask again
+            fail(error_expected_expression, "expected an argument", index);
+            param = error_node(index);
         }
-        if (current.kind == Tok_Comma) next_token();
+        scratch.push_back(param);
+        if (current == Tok_Comma) next_token();
     }
-    return new CallExpr(fn_name, list);
+    expectToken(Tok_RParen);
+    uint32_t args = ast.add_extra(pop_list(top));
+    return ast.add_node(Ast_Call, fn_name, {symbol, args});
 }
 
-auto Parser::parseFnDecl() -> Decl* {
+auto Parser::parseFnDecl() -> NodeIndex {
     next_token(); // eat fn keyword
-    Token name = expectToken(Tok_Identifier);
+    auto name = expectToken(Tok_Identifier);
+    // before the body, see parseFnCall()
+    SymbolId symbol = symbol_at(name);
     auto params = parseFnDeclParams();
     expectToken(Tok_Arrow);
     auto ret_type = parseTypeExpr();
-    auto body_s = parseBlock();
-    auto blk = static_cast<Block*>(body_s);
-    return new FnDecl(name, params, ret_type, blk);
+    // skip the rest of a broken prototype, the body can still be checked
+    if (panicking) {
+        while (current != Tok_LBrace && current != Tok_Semicolon && current != Tok_RBrace &&
+               current != Tok_Keyword_fn && current != Tok_Eof)
+            next_token();
+        if (current == Tok_LBrace) panicking = false;
+    }
+    NodeIndex body = lazy_bodies ? skipBody() : 0;
+    if (!body) body = parseBlock();
+    uint32_t proto = ast.add_extra(FnProto{symbol, params, ret_type});
+    return ast.add_node(Ast_FnDecl, name, {proto, body});
 }
 
-auto Parser::parseVarDecl() -> Decl* {
-    auto var_or_const = next_token(); // eat var keyword
-    auto name_token = next_token();
-    auto var_name = new Literal(Ast_Identifier, name_token);
-    if (current.kind == Tok_Semicolon) {
-        fprintf(stderr, "[ParsingError]: expected variable declaration\n");
-        exit(0);
+// The `}` matching the `{` at `l_brace`, by the token kinds alone. The Eof token if it
+// isn't closed.
+auto matching_brace(const TokenList& tokens, TokenIndex l_brace) -> TokenIndex {
+    uint32_t depth = 0;
+    for (TokenIndex i = l_brace;; i++) {
+        switch (tokens.kind(i)) {
+        case Tok_LBrace:
+            depth++;
+            break;
+        case Tok_RBrace:
+            if (--depth == 0) return i;
+            break;
+        case Tok_Eof:
+            return i;
+        default:
+            break;
+        }
     }
-    if (current.kind != Tok_Colon) {
-        Token eql_tok = expectToken(Tok_Equal);
-        Expr* value_expr = parseExpr();
+}
 
-        return new VarDecl(var_name, nullptr, value_expr);
-    }
-    auto colon = next_token();
-    Type* decl_type = parseTypeExpr();
-    if (current.kind == Tok_Semicolon) {
-        next_token();
-        return new VarDecl(var_name, decl_type, nullptr);
-    }
+// Steps over a body to its matching `}`, 0 if the braces don't match up and the body has
+// to be parsed now to report that
+auto Parser::skipBody() -> NodeIndex {
+    if (stream || current != Tok_LBrace) return 0;
+    TokenIndex r_brace = matching_brace(tokens, index);
+    if (tokens.kind(r_brace) != Tok_RBrace) return 0;
+    NodeIndex body = ast.add_node(Ast_LazyBody, index, {r_brace - index, 0});
+    index = r_brace;
+    next_token();
+    return body;
+}
 
-    Token eql_tok = expectToken(Tok_Equal);
-    Expr* value_expr = parseExpr();
-    return new VarDecl(var_name, decl_type, value_expr);
+auto Parser::parseBody(NodeIndex fn) -> NodeIndex {
+    NodeIndex body = ast.data(fn).rhs;
+    if (!body || ast.tag(body) != Ast_LazyBody) return body;
+    TokenIndex resume = index;
+    index = ast.main_token(body);
+    current = kind_at(index);
+    body = parseBlock();
+    panicking = false;
+    ast.datas[fn].rhs = body;
+    index = resume;
+    current = kind_at(index);
+    return body;
 }
 
-auto Parser::parseConstDecl() -> Decl* {
-    auto const_tok = next_token(); // eat const keyword
-    auto name_token = next_token();
-    auto var_name = new Literal(Ast_Identifier, name_token);
-    if (current.kind == Tok_Semicolon) {
-        fprintf(stderr, "[ParsingError]: expected variable declaration\n");
-        exit(0);
+auto Parser::parseBodies() -> void {
+    // by index, parseBody() appends to extra_data
+    SubRange stmts = {ast.data(0).lhs, ast.data(0).rhs};
+    for (uint32_t i = stmts.start; i < stmts.end; i++) {
+        NodeIndex stmt = ast.extra_data[i];
+        if (stmt && ast.tag(stmt) == Ast_FnDecl) parseBody(stmt);
     }
-    if (current.kind != Tok_Colon) {
-        Token eql_tok = expectToken(Tok_Equal);
-        Expr* value_expr = parseExpr();
+}
 
-        return new ConstDecl(var_name, nullptr, value_expr);
+// var and const declarations only differ in their tag
+static auto parse_decl(Parser& p, NodeKind tag) -> NodeIndex {
+    auto var_or_const = p.next_token(); // eat var or const keyword
+    auto name_token = p.expectToken(Tok_Identifier);
+    if (p.panicking) return p.error_node(name_token);
+    VarDeclInfo info = {p.symbol_at(name_token), 0, 0};
+    if (p.current == Tok_Semicolon) {
+        p.fail(error_expected_var_decl, "expected a type or a value after the name", p.index);
+        return p.error_node(name_token);
     }
-    auto colon = next_token();
-    Type* decl_type = parseTypeExpr();
-    if (current.kind == Tok_Semicolon) {
-        next_token();
-        return new ConstDecl(var_name, decl_type, nullptr);
+    if (p.current != Tok_Colon) {
+        p.expectToken(Tok_Equal);
+        info.value = p.expectExpr();
+        return p.ast.add_node(tag, name_token, {p.ast.add_extra(info), 0});
+    }
+    auto colon = p.next_token();
+    info.type = p.parseTypeExpr();
+    if (p.current == Tok_Semicolon) {
+        p.next_token();
+        return p.ast.add_node(tag, name_token, {p.ast.add_extra(info), 0});
     }
 
-    Token eql_tok = expectToken(Tok_Equal);
-    Expr* value_expr = parseExpr();
-    return new ConstDecl(var_name, decl_type, value_expr);
+    p.expectToken(Tok_Equal);
+    info.value = p.expectExpr();
+    return p.ast.add_node(tag, name_token, {p.ast.add_extra(info), 0});
 }
 
-// auto Parser::parseStatement() -> Stmt* {
-//     Stmt* result = nullptr;
-//     switch (current.kind) {
-//     case Tok_Keyword_var: {
-//         result = parseVarDecl();
-//         //expectToken(Tok_Semicolon);
-//     }
-//     case Tok_Keyword_const: {
-//         result = parseConstDecl();
-//       //  expectToken(Tok_Semicolon);
-//     }
-//     case Tok_Keyword_if: {
-//         result = parseIfStmt();
-//     }
-//     case Tok_Identifier: {
-//         result = parseAssignExpr();
-//         expectToken(Tok_Semicolon);
-//     }
-//     case Tok_Keyword_for:
-//     case Tok_Keyword_while: {
-//         fail(error_unexpected_token, "for and while loops are not implmented yet", current);
-//         return nullptr;
-//     }
-//     default:
-//         return nullptr;
-//     }
-//     return result;
-// }
-
-auto Parser::parseStatement() -> Stmt* {
-    Stmt* result = nullptr;
-    switch (current.kind) {
+auto Parser::parseVarDecl() -> NodeIndex { return parse_decl(*this, Ast_VarDecl); }
+
+auto Parser::parseConstDecl() -> NodeIndex { return parse_decl(*this, Ast_ConstDecl); }
+
+auto Parser::parseStatement() -> NodeIndex {
+    NodeIndex result = 0;
+    switch (current) {
     case Tok_Keyword_var: {
         result = parseVarDecl();
         expectToken(Tok_Semicolon);
     } break;
     case Tok_Keyword_const: {
-        return parseConstDecl();
+        result = parseConstDecl();
         expectToken(Tok_Semicolon);
     } break;
     case Tok_Keyword_if: {
         result = parseIfStmt();
     } break;
     case Tok_Identifier: {
-        switch (tokens[index + 1].kind) {
+        switch (peek_kind(1)) {
         case Tok_LParen: {
             result = parseFnCall();
             expectToken(Tok_Semicolon);
@@ -402,100 +525,160 @@ auto Parser::parseStatement() -> Stmt* {
         result = parseLoop();
     } break;
     case Tok_Keyword_while: {
-        fail(error_unexpected_token, "for and while loops are not implmented yet", current);
-        return nullptr;
+        report(error_unexpected_token, "while loops are not implemented yet", index);
+        result = parseLoop();
     } break;
     default:
-        return nullptr;
+        // skipped, so synchronize() doesn't stop right where it started
+        fail(error_expected_statement, "expected a statement", index);
+        return error_node(next_token());
     }
     return result;
 }
 
-auto Parser::parseIfStmt() -> Stmt* {
+auto Parser::parseIfStmt() -> NodeIndex {
     auto if_tok = expectToken(Tok_Keyword_if);
-    auto cond_expr = parseExpr();
-    auto then_expr = parseBlock();
-    return new IfStmt(Ast_If_Simple, cond_expr, then_expr);
+    auto cond_expr = expectExpr();
+    // a missing condition is reported, the block can still be checked
+    if (panicking && current == Tok_LBrace) panicking = false;
+    auto then_block = parseBlock();
+    return ast.add_node(Ast_If_Simple, if_tok, {cond_expr, then_block});
 }
 
-auto Parser::parseBlock() -> Stmt* {
-    auto l_brace = expectToken(Tok_LBrace);
-    auto blk = new Block;
+// Blocks nested through `if` and `for` are parsed in this one loop, with the blocks that
+// are still open on `open_blocks`. The `if` or `for` node is made when its block closes.
+// A block still open at Eof, or at a `fn` (functions don't nest), is reported once and
+// closed along with everything around it.
+auto Parser::parseBlock() -> NodeIndex {
+    if (current != Tok_LBrace) return error_node(expectToken(Tok_LBrace));
+    size_t base = open_blocks.size();
+    auto l_brace = next_token();
+    open_blocks.push_back({Ast_None, 0, 0, l_brace, (uint32_t)scratch.size()});
     while (true) {
-        if (current.kind == Tok_RBrace || current.kind == Tok_Semicolon) {
-            break;
+        switch (current) {
+        case Tok_RBrace:
+        case Tok_Eof:
+        case Tok_Keyword_fn: {
+            if (current == Tok_RBrace) {
+                next_token();
+                panicking = false;
+            } else {
+                expectToken(Tok_RBrace);
+            }
+            OpenBlock block = open_blocks.back();
+            open_blocks.pop_back();
+            SubRange stmts = pop_list(block.top);
+            NodeIndex node = ast.add_node(Ast_Block, block.l_brace, {stmts.start, stmts.end});
+            if (block.owner != Ast_None)
+                node = ast.add_node(block.owner, block.owner_token, {block.head, node});
+            if (open_blocks.size() == base) return node;
+            scratch.push_back(node);
+        } break;
+        case Tok_Semicolon: {
+            report(error_unexpected_token, "empty statement", index);
+            next_token();
+        } break;
+        case Tok_Keyword_if:
+        case Tok_Keyword_for:
+        case Tok_Keyword_while: {
+            if (current == Tok_Keyword_while)
+                report(error_unexpected_token, "while loops are not implemented yet", index);
+            NodeKind owner = current == Tok_Keyword_if ? Ast_If_Simple : Ast_SimpleLoop;
+            auto owner_token = next_token();
+            // `for {` loops until a break, an `if` needs its condition
+            auto head = owner == Ast_If_Simple ? expectExpr() : parseExpr();
+            if (panicking && current == Tok_LBrace) panicking = false;
+            if (current != Tok_LBrace) {
+                expectToken(Tok_LBrace);
+                scratch.push_back(error_node(owner_token));
+                synchronize(false);
+                break;
+            }
+            l_brace = next_token();
+            open_blocks.push_back({owner, owner_token, head, l_brace, (uint32_t)scratch.size()});
+        } break;
+        default: {
+            auto stmt = parseStatement();
+            scratch.push_back(stmt);
+            if (panicking) synchronize(false);
+        } break;
         }
-        auto stmt = parseStatement();
-        blk->stmts.push_back(stmt);
     }
-    expectToken(Tok_RBrace);
-    return blk;
 }
 
 // for{ } loop until break;
-auto Parser::parseLoop() -> Stmt* {
-    Token for_tok = expectToken(Tok_Keyword_for);
-	auto expr  = parseExpr();
-    auto body_stmt = parseBlock();
-    Block* body = static_cast<Block*>(body_stmt);
-    return new LoopStmt(Ast_SimpleLoop, nullptr, nullptr, expr, body);
+auto Parser::parseLoop() -> NodeIndex {
+    auto for_tok = next_token(); // `for`, or `while` after it was reported
+    auto expr = parseExpr();
+    auto body = parseBlock();
+    return ast.add_node(Ast_SimpleLoop, for_tok, {expr, body});
 }
 
-auto Parser::parseTopLevelStmts() -> vector<Stmt*> {
-    vector<Stmt*> list = {};
-    Stmt* result = nullptr;
-
-    while (true) {
-        switch (current.kind) {
-        case Tok_Eof: {
-            return list;
-        }
+// The root is node 0, its statements are filled in once they are all parsed. A statement
+// with a syntax error is kept (with Ast_Error nodes where parts are missing) and parsing
+// starts over at the next one, see synchronize().
+auto Parser::parseRoot() -> void {
+    ast.clear();
+    root_starts.clear();
+    root_errors.clear();
+    ast.add_node(Ast_Root, 0, {0, 0});
+    size_t top = scratch.size();
+    while (current != Tok_Eof) {
+        root_starts.push_back(index);
+        root_errors.push_back(errors.size());
+        scratch.push_back(parseTopLevel());
+    }
+    SubRange stmts = pop_list(top);
+    ast.datas[0] = {stmts.start, stmts.end};
+    parsed_size = ast.size() + ast.extra_data.size();
+}
 
-        case Tok_Keyword_fn: {
-            result = parseFnDecl();
-            // expectToken(Tok_Semicolon);
-            list.push_back(result);
-        } break;
-        case Tok_Keyword_var: {
-            result = parseVarDecl();
+// One top level statement, and the tokens after it that recovering from an error in it
+// skips. The parser is in the same state after each one, which is what lets
+// parseRootParallel() and reparse() start in the middle of a file.
+auto Parser::parseTopLevel() -> NodeIndex {
+    NodeIndex result = 0;
+    switch (current) {
+    case Tok_Keyword_fn: {
+        result = parseFnDecl();
+        // expectToken(Tok_Semicolon);
+    } break;
+    case Tok_Keyword_var: {
+        result = parseVarDecl();
+        expectToken(Tok_Semicolon);
+    } break;
+    case Tok_Keyword_const: {
+        result = parseConstDecl();
+        expectToken(Tok_Semicolon);
+    } break;
+    case Tok_Keyword_if: {
+        result = parseIfStmt();
+    } break;
+    case Tok_Identifier: {
+        switch (peek_kind(1)) {
+        case Tok_LParen: {
+            result = parseFnCall();
             expectToken(Tok_Semicolon);
-            list.push_back(result);
         } break;
-        case Tok_Keyword_const: {
-            result = parseConstDecl();
+        default: {
+            result = parseAssignExpr();
             expectToken(Tok_Semicolon);
-            list.push_back(result);
-        } break;
-        case Tok_Keyword_if: {
-            result = parseIfStmt();
-            list.push_back(result);
         } break;
-        case Tok_Identifier: {
-            switch (tokens[index + 1].kind) {
-            case Tok_LParen: {
-                result = parseFnCall();
-                expectToken(Tok_Semicolon);
-                list.push_back(result);
-            } break;
-            default: {
-                result = parseAssignExpr();
-                expectToken(Tok_Semicolon);
-                list.push_back(result);
-            } break;
-            }
-        } break;
-        case Tok_Keyword_for: {
-            result = parseLoop();
-            list.push_back(result);
-        } break;
-        case Tok_Keyword_while: {
-            fail(error_unexpected_token, "for and while loops are not implmented yet", current);
-            return {};
-        } break;
-        default:
-            fail("parsing top level statements", current);
-            break;
         }
+    } break;
+    case Tok_Keyword_for: {
+        result = parseLoop();
+    } break;
+    case Tok_Keyword_while: {
+        report(error_unexpected_token, "while loops are not implemented yet", index);
+        result = parseLoop();
+    } break;
+    default:
+        fail(error_expected_statement, "expected a declaration or statement", index);
+        result = error_node(next_token());
+        break;
     }
+    if (panicking) synchronize(true);
+    return result;
 }
-auto Parser::parseWhileLoop() -> Stmt* { return nullptr; }
+auto Parser::parseWhileLoop() -> NodeIndex { return 0; }
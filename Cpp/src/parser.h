@@ -1,8 +1,10 @@
 #pragma once
 
+#include "ast.h"
 #include "diagnostics.h"
 #include "lexer.h"
 #include "tree.h"
+#include <optional>
 #include <stdint.h>
 
 enum ErrorKind {
@@ -11,98 +13,218 @@ enum ErrorKind {
     error_expected_type_expr,
     error_expected_var_decl,
     error_expected_fnuction_call,
+    error_expected_token,
+    error_expected_statement,
 };
 struct Error {
     ErrorKind kind;
     const char* msg;
     const char* caller_fn;
-    Token token;   // Location of error
-    bool is_fatal; // Determines if parsing should stop
+    TokenIndex token;   // Location of error
+    TokenKind expected; // for error_expected_token
 };
 
 auto enum_to_str(ErrorKind kind) -> const char*;
 
-struct Parser {
-    Lexer lexer;
-    string& source;
-    vector<Token> tokens;
-    vector<Error> errors;
-    Token current;
-    uint32_t index = 0;
+enum EmitFormat {
+    Emit_Tree,  // indented text, what the Node classes of tree.h print
+    Emit_Json,  // an object per node
+    Emit_Sexpr, // a list per node
+};
 
-    Parser(string& _source) : lexer(_source), source(_source) {
-        Token tok = lexer.next_token();
+struct OutBuffer;
 
-        tokens.reserve(source.size() / 4);
-        while (true) {
-            tokens.push_back(tok);
-            if (tok.kind == Tok_Eof) break;
-            tok = lexer.next_token();
-        }
-        current = tokens[0];
-    }
+enum ParseMode {
+    Parse_Full,   // lex the whole file up front into `tokens`
+    Parse_Stream, // pull tokens from the lexer through a fixed size TokenRing, `tokens`
+                  // stays empty and the ring keeps the starts the nodes point at
+};
+
+// A binary operator whose right operand is still being parsed, see parsePrecedenceExpr()
+struct PendingOp {
+    TokenIndex token;
+    NodeKind tag;
+    int prec;
+};
+
+// A block that is still open, with the `if` or `for` it belongs to, see parseBlock()
+struct OpenBlock {
+    NodeKind owner; // Ast_If_Simple, Ast_SimpleLoop, or Ast_None for the outermost block
+    TokenIndex owner_token;
+    NodeIndex head; // condition or loop expression
+    TokenIndex l_brace;
+    uint32_t top; // scratch size when the block was opened
+};
+
+// What reparse() parsed again
+struct Reparsed {
+    NodeKind kind; // Ast_Block (or Ast_LazyBody), Ast_Root for top level statements, or
+                   // Ast_None when the whole file was parsed again
+    uint32_t tokens;
+};
+
+// parseRootParallel() doesn't split files into parts smaller than this
+constexpr uint32_t parallel_parse_min_tokens = 1 << 14;
 
-    auto fail(ErrorKind kind, const char* msg, Token token, bool is_fatal = true) {
-        errors.push_back({kind, msg, __func__, token, is_fatal});
-        if (is_fatal) {
-            fprintf(stderr, "[ParsingError]: %s at [%d,%d] { %s : `%s` }\nMessage: %s\n",
-                    enum_to_str(kind), token.loc.line, token.loc.column, enum_to_str(token.kind),
-                    token.buf.c_str(), msg);
+// the `}` matching the `{` at `l_brace`, the Eof token if there is none
+auto matching_brace(const TokenList& tokens, TokenIndex l_brace) -> TokenIndex;
 
-            exit(1); // Fatal error, exit
+struct Parser {
+    string_view source;
+    TokenList tokens; // empty in Parse_Stream mode
+    std::optional<TokenRing> stream;
+    CommentTable comments; // doc comments, filled while lexing
+    LineTable lines;       // built the first time a location is needed
+    vector<Error> errors;
+    uint32_t max_errors = 0; // stop parsing after this many, 0 for no limit
+    bool panicking = false;  // see fail()
+    // leave function bodies as Ast_LazyBody until parseBody(), for when only the
+    // signatures are needed. Not in Parse_Stream mode, the tokens are gone by then.
+    bool lazy_bodies = false;
+    TokenKind current;
+    TokenIndex index = 0;
+    uint32_t literal_hint = 0; // see TokenList::literal
+    Ast ast;
+    vector<TokenIndex> root_starts; // first token of each top level statement
+    vector<uint32_t> root_errors;   // and the first of `errors` it reported
+    uint32_t parsed_size = 0;       // nodes and extra words after the last full parse
+    // children of the lists being parsed, nested lists push on top of their parent's
+    // and pop_list() moves them into ast.extra_data once the list is complete
+    vector<NodeIndex> scratch;
+    // Expressions, types and nested blocks are parsed with these explicit stacks rather
+    // than by recursion, so nesting depth is only limited by memory. Like `scratch`
+    // they're kept around between uses.
+    vector<PendingOp> operators;
+    vector<OpenBlock> open_blocks;
+    Arena arena; // owns the pointer tree of debug_tree(), if one was made
+
+    Parser(string_view _source, ParseMode mode = Parse_Full) : source(_source) {
+        if (mode == Parse_Stream) {
+            stream.emplace(source);
+            stream->lexer.comments = &comments;
+        } else {
+            tokens = tokenize(source, &comments);
+            ast.reserve(tokens.size());
         }
+        current = kind_at(0);
+        // the root points at the first token, whatever it is
+        if (stream) stream->pin(0);
     }
+    // the stream lexer points at `comments`
+    Parser(const Parser&) = delete;
 
-    auto fail(string error_msg, Token token) -> void {
-        fprintf(stderr, Color_Bright_red "Error -> " Color_Reset "at [line = %d, column = %d]: %s\n",
-                token.loc.line, token.loc.column, error_msg.c_str());
-        fprintf(stderr, Color_Bright_red "error line => " Color_Reset);
-        fprintf(stderr, "%s\n", get_line_of(current).c_str());
-		exit(0);
+    // parse an already lexed source, e.g. from tokenize_parallel()
+    Parser(string_view _source, TokenList&& _tokens)
+        : source(_source), tokens(static_cast<TokenList&&>(_tokens)) {
+        ast.reserve(tokens.size());
+        current = kind_at(0);
     }
 
-    auto warn(ErrorKind kind, const char* msg, Token token) {
-        errors.push_back({kind, msg, __func__, token, false});
-        fprintf(stderr, "[ParsingError]: %s at [%d,%d] { %s : `%s` }\nMessage: %s\n",
-                enum_to_str(kind), token.loc.line, token.loc.column, enum_to_str(token.kind),
-                token.buf.c_str(), msg);
+    // Records a syntax error the parser can carry on right after, it knows where it is.
+    // Nothing is recorded in panic mode or past max_errors.
+    auto report(ErrorKind kind, const char* msg, TokenIndex token,
+                TokenKind expected = Tok_Invalid, const char* caller = __builtin_FUNCTION()) {
+        if (panicking || gave_up()) return;
+        errors.push_back({kind, msg, caller, token, expected});
+        if (stream) stream->pin(token);
+        // stop at the cap, every parse loop ends at Eof
+        if (gave_up()) current = Tok_Eof;
     }
+    // Records a syntax error and enters panic mode: the parse functions still finish what
+    // they started (with Ast_Error nodes for the missing parts) but report nothing more
+    // until synchronize() skips to the next statement, so one mistake is one error.
+    auto fail(ErrorKind kind, const char* msg, TokenIndex token, TokenKind expected = Tok_Invalid,
+              const char* caller = __builtin_FUNCTION()) {
+        report(kind, msg, token, expected, caller);
+        panicking = true;
+    }
+    auto gave_up() const -> bool { return max_errors && errors.size() >= max_errors; }
 
-    auto printErrors() {
-        for (const auto& error : errors) {
-            fprintf(stderr, Color_Red "Error" Color_Reset " in %s: %s\n", error.caller_fn,
-                    error.msg);
-            // Include token position or other information
-        }
+    auto warn(ErrorKind kind, const char* msg, TokenIndex token) {
+        errors.push_back({kind, msg, __func__, token, Tok_Invalid});
+        if (stream) stream->pin(token);
+        auto loc = location_of(token);
+        fprintf(stderr, "[ParsingError]: %s at [%d,%d] { %s : `" SV_FMT "` }\nMessage: %s\n",
+                enum_to_str(kind), loc.line, loc.column, enum_to_str(kind_at(token)),
+                SV_ARG(token_at(token).buf), msg);
     }
+
+    auto printErrors() -> void;
     auto has_errors() const -> bool { return !errors.empty(); }
 
-    auto next_token() -> Token;
-    auto expectToken(TokenKind kind) -> Token;
-    auto get_line_of(Token token) -> string;
-
-    auto parseTypeExpr() -> Type*;
-    auto parseExpr() -> Expr*;
-    auto expectExpr() -> Expr*;
-    auto parsePrimaryExpr() -> Expr*;
-    auto parsePrefixExpr() -> Expr*;
-    auto parsePrecedenceExpr(int min) -> Expr*;
-    auto parseAssignExpr() -> Expr*;
-    auto parseIfExpr() -> Expr*;
-    auto parseParamDecl() -> Decl*;
-    auto parseFnDeclParams() -> ParamList*;
-    auto parseFnProto() -> Stmt*;
-    auto parseTopLevelStmts() -> vector<Stmt*>;
-    auto parseFnDecl() -> Decl*;
-    auto parseFnCall() -> Expr*;
-    auto parseVarDecl() -> Decl*;
-    auto parseConstDecl() -> Decl*;
-    auto parseMacroFn() -> Decl*;
-    auto parsePayLoad() -> Decl*;
-    auto parseBlock() -> Stmt*;
-    auto parseStatement() -> Stmt*;
-    auto parseIfStmt() -> Stmt*;
-    auto parseLoop() -> Stmt*;
-    auto parseForLoop() -> Stmt*;
-    auto parseWhileLoop() -> Stmt*;
-};
+    auto next_token() -> TokenIndex;
+    auto synchronize(bool top_level) -> void;
+    auto error_node(TokenIndex token) -> NodeIndex { return ast.add_node(Ast_Error, token, {0, 0}); }
+    auto kind_at(TokenIndex i) -> TokenKind { return stream ? stream->kind(i) : tokens.kind(i); }
+    auto start_at(TokenIndex i) -> ByteOffset { return stream ? stream->start(i) : tokens.start(i); }
+    // decoded value of the literal at `i`, see TokenList::literal_values
+    auto literal_at(TokenIndex i) -> uint64_t {
+        return stream ? stream->literal(i) : tokens.literal(i, &literal_hint);
+    }
+    // interned name of the identifier at `i`, no_symbol for anything else
+    auto symbol_at(TokenIndex i) -> SymbolId {
+        return kind_at(i) == Tok_Identifier ? (SymbolId)literal_at(i) : no_symbol;
+    }
+    auto pop_list(size_t top) -> SubRange {
+        SubRange list = ast.add_list(scratch.data() + top, (uint32_t)(scratch.size() - top));
+        scratch.resize(top);
+        return list;
+    }
+    auto peek_kind(uint32_t offset) -> TokenKind { return kind_at(index + offset); }
+    auto expectToken(TokenKind kind, const char* caller = __builtin_FUNCTION()) -> TokenIndex;
+    auto token_at(TokenIndex i) -> Token;
+    auto location_of(TokenIndex i) -> Location;
+    auto get_line_of(TokenIndex i) -> string;
+
+    // The parse functions return the index of the node they added to `ast`, 0 for
+    // nothing parsed.
+    auto parseRoot() -> void;
+    // Same tree as parseRoot(), with the top level declarations split into parts that are
+    // parsed on `jobs` threads, see parse_parallel.c. Files with syntax errors end up
+    // parsed by parseRoot() anyway.
+    auto parseRootParallel(uint32_t jobs) -> void;
+    auto parseTopLevel() -> NodeIndex;
+    // Brings `tokens`, `ast` and `errors` up to date after `edit`, which turned the source
+    // into `new_source`. Only the innermost block around the edit is parsed again, or else
+    // the top level statements it touched, and spliced into the tree, see reparse.c.
+    // Parse_Full only. `comments` isn't updated, its offsets are from before the edit.
+    auto reparse(string_view new_source, const SourceEdit& edit) -> Reparsed;
+    auto parseTypeExpr() -> NodeIndex;
+    auto parseExpr() -> NodeIndex;
+    auto expectExpr() -> NodeIndex;
+    auto parsePrimaryExpr() -> NodeIndex;
+    auto parseLiteral() -> NodeIndex;
+    auto parsePrefixExpr() -> NodeIndex;
+    auto parsePrecedenceExpr(int min) -> NodeIndex;
+    auto parseAssignExpr() -> NodeIndex;
+    auto parseIfExpr() -> NodeIndex;
+    auto parseParamDecl() -> NodeIndex;
+    auto parseFnDeclParams() -> NodeIndex;
+    auto parseFnProto() -> NodeIndex;
+    auto parseFnDecl() -> NodeIndex;
+    auto parseFnCall() -> NodeIndex;
+    auto parseVarDecl() -> NodeIndex;
+    auto parseConstDecl() -> NodeIndex;
+    auto parseMacroFn() -> NodeIndex;
+    auto parsePayLoad() -> NodeIndex;
+    auto parseBlock() -> NodeIndex;
+    auto skipBody() -> NodeIndex;
+    // Parses the body of FnDecl `fn` if it was skipped and returns it, syntax errors in it
+    // are only found then. The new nodes go at the end of `ast`.
+    auto parseBody(NodeIndex fn) -> NodeIndex;
+    // parseBody() for every function
+    auto parseBodies() -> void;
+    auto parseStatement() -> NodeIndex;
+    auto parseIfStmt() -> NodeIndex;
+    auto parseLoop() -> NodeIndex;
+    auto parseForLoop() -> NodeIndex;
+    auto parseWhileLoop() -> NodeIndex;
+
+    // writes `ast` to `out` as `format`, see ast_print.c
+    auto emit_ast(OutBuffer& out, EmitFormat format) -> void;
+    // emit_ast() as Emit_Tree to stdout
+    auto print_tree() -> void;
+    // The top level statements as a tree of Node objects in `arena`, for printing.
+    // Built from `ast` after parseRoot(), see tree.c.
+    auto debug_tree() -> vector<Stmt*>;
+};
\ No newline at end of file
@@ -0,0 +1,176 @@
+#include "parser.h"
+#include <algorithm>
+
+namespace {
+// A block around the edit and the FnDecl, If_Simple or SimpleLoop it belongs to
+struct EnclosingBlock {
+    NodeIndex owner;
+    NodeIndex block; // Ast_Block or Ast_LazyBody
+    TokenIndex r_brace;
+};
+
+// The innermost block under top level statement `stmt` whose braces are around all of
+// tokens [first, last). Only asked when the edit added or removed no braces, so every
+// `{` still matches the `}` it did.
+auto find_block(const Ast& ast, const TokenList& tokens, NodeIndex stmt, TokenIndex first,
+                TokenIndex last) -> EnclosingBlock {
+    EnclosingBlock found = {0, 0, 0};
+    NodeIndex owner = stmt;
+    while (owner) {
+        NodeKind tag = ast.tag(owner);
+        if (tag != Ast_FnDecl && tag != Ast_If_Simple && tag != Ast_SimpleLoop) break;
+        NodeIndex block = ast.data(owner).rhs;
+        if (!block || (ast.tag(block) != Ast_Block && ast.tag(block) != Ast_LazyBody)) break;
+        TokenIndex l_brace = ast.main_token(block);
+        if (l_brace >= first) break;
+        TokenIndex r_brace = matching_brace(tokens, l_brace);
+        if (r_brace < last || tokens.kind(r_brace) != Tok_RBrace) break;
+        found = {owner, block, r_brace};
+        if (ast.tag(block) == Ast_LazyBody) break;
+        // the last statement starting before the edit is the only one whose block can
+        // be around it, statements with a block have their first token as main_token
+        owner = 0;
+        for (NodeIndex child : ast.list(block)) {
+            if (!child) continue;
+            if (ast.main_token(child) >= first) break;
+            owner = child;
+        }
+    }
+    return found;
+}
+
+// items [first, last) replaced by `with`
+template <typename T>
+void splice(vector<T>& items, uint32_t first, uint32_t last, const vector<T>& with) {
+    items.erase(items.begin() + first, items.begin() + last);
+    items.insert(items.begin() + first, with.begin(), with.end());
+}
+} // namespace
+
+// Old nodes and lists that get replaced stay in `ast`, nothing points at them anymore.
+// Once the tree has grown to twice what a full parse made, it is parsed again whole.
+auto Parser::reparse(string_view new_source, const SourceEdit& edit) -> Reparsed {
+    TokenEdit change = relex(tokens, new_source, edit);
+    source = new_source;
+    lines = LineTable();
+    literal_hint = 0;
+    panicking = false;
+
+    auto parse_all = [&] {
+        errors.clear();
+        index = 0;
+        current = kind_at(0);
+        parseRoot();
+        return Reparsed{Ast_None, tokens.size()};
+    };
+    uint32_t count = root_starts.size();
+    // the error cap stops parsing partway, so the tree may not cover the whole file
+    if (max_errors || ast.size() + ast.extra_data.size() > parsed_size * 2 ||
+        count != ast.list(0).size())
+        return parse_all();
+
+    // old numbering: the edit replaced tokens [begin, old_end)
+    TokenIndex old_end = change.begin + change.removed;
+    int32_t delta = (int32_t)change.inserted - (int32_t)change.removed;
+    // new numbering: [first, last) are the relexed tokens
+    TokenIndex first = change.begin;
+    TokenIndex last = change.begin + change.inserted;
+
+    // top level statement the edit starts in, and the first one after it, which is kept
+    uint32_t k = std::upper_bound(root_starts.begin(), root_starts.end(), first) -
+                 root_starts.begin();
+    if (k > 0) k--;
+    uint32_t j =
+        std::lower_bound(root_starts.begin() + k, root_starts.end(), old_end) - root_starts.begin();
+
+    // everything after the edit moves along
+    if (delta != 0) {
+        // but the root, which stays at 0
+        for (NodeIndex i = 1; i < ast.size(); i++) {
+            if (ast.main_tokens[i] >= old_end) ast.main_tokens[i] += delta;
+        }
+        for (uint32_t i = j; i < count; i++) root_starts[i] += delta;
+        for (Error& error : errors) {
+            if (error.token >= old_end) error.token += delta;
+        }
+    }
+
+    // errors [first_error, end_error) are the ones of statements [k, j)
+    uint32_t first_error = count ? root_errors[k] : 0;
+    uint32_t end_error = j < count ? root_errors[j] : errors.size();
+
+    // An edit inside a single statement that leaves the braces alone: parse only the
+    // innermost block around it. Unless the statement has errors outside of that block,
+    // they may have changed how the block was parsed, or the statement ended before the
+    // block did, at a `fn` in it.
+    if (!change.braces_changed && j == k + 1 && ast.list(0)[k]) {
+        EnclosingBlock found = find_block(ast, tokens, ast.list(0)[k], first, last);
+        TokenIndex l_brace = found.block ? ast.main_token(found.block) : 0;
+        TokenIndex stmt_end = j < count ? root_starts[j] : tokens.size() - 1;
+        bool errors_inside = stmt_end > found.r_brace && std::all_of(
+            errors.begin() + first_error, errors.begin() + end_error,
+            [&](const Error& e) { return e.token >= l_brace && e.token <= found.r_brace; });
+        if (found.block && errors_inside) {
+            vector<Error> kept = static_cast<vector<Error>&&>(errors);
+            errors.clear();
+            index = l_brace;
+            current = kind_at(index);
+            NodeIndex block = lazy_bodies && ast.tag(found.block) == Ast_LazyBody ? skipBody() : 0;
+            if (!block) block = parseBlock();
+            // it can still end elsewhere, at a `fn` that was typed into it
+            if (index == found.r_brace + 1) {
+                ast.datas[found.owner].rhs = block;
+                for (uint32_t i = j; i < count; i++)
+                    root_errors[i] += errors.size() - (end_error - first_error);
+                splice(kept, first_error, end_error, errors);
+                errors = static_cast<vector<Error>&&>(kept);
+                return {ast.tag(block), found.r_brace + 1 - l_brace};
+            }
+            errors = static_cast<vector<Error>&&>(kept);
+            panicking = false;
+        }
+    }
+
+    // Top level statements then, from the one with the edit until the parser lands on the
+    // start of an old statement past it: from there on it would parse the same tokens the
+    // same way again. A statement before that recovered from an error may have skipped
+    // into the edited one, it goes too.
+    if (k > 0 && root_errors[k - 1] != root_errors[k]) first_error = root_errors[--k];
+    // j == k for text inserted right before statement k, which has moved along already
+    TokenIndex start = k < j ? root_starts[k] : first;
+    vector<Error> kept = static_cast<vector<Error>&&>(errors);
+    errors.clear();
+    index = start;
+    current = kind_at(index);
+    size_t top = scratch.size();
+    vector<TokenIndex> starts;
+    vector<uint32_t> first_errors;
+    while (current != Tok_Eof) {
+        while (j < count && root_starts[j] < index) j++;
+        if (j < count && root_starts[j] == index) break;
+        starts.push_back(index);
+        first_errors.push_back(first_error + errors.size());
+        scratch.push_back(parseTopLevel());
+    }
+    if (current == Tok_Eof) j = count;
+    end_error = j < count ? root_errors[j] : kept.size();
+
+    auto old_list = ast.list(0);
+    vector<NodeIndex> list(old_list.begin(), old_list.begin() + k);
+    list.insert(list.end(), scratch.begin() + top, scratch.end());
+    list.insert(list.end(), old_list.begin() + j, old_list.end());
+    scratch.resize(top);
+    SubRange stmts = ast.add_list(list.data(), list.size());
+    ast.datas[0] = {stmts.start, stmts.end};
+
+    for (uint32_t i = j; i < count; i++)
+        root_errors[i] += errors.size() - (end_error - first_error);
+    splice(root_starts, k, j, starts);
+    splice(root_errors, k, j, first_errors);
+    splice(kept, first_error, end_error, errors);
+    errors = static_cast<vector<Error>&&>(kept);
+    Reparsed result = {Ast_Root, index - start};
+    index = tokens.size() - 1;
+    current = Tok_Eof;
+    return result;
+}
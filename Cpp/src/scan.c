@@ -0,0 +1,473 @@
+#include "scan.h"
+#include "unicode.h"
+#include <string.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#define SCAN_X86 1
+#include <immintrin.h>
+#endif
+
+//
+// Scalar fallback
+//
+
+static inline bool is_ident_char(char c) {
+    return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') || c == '_';
+}
+
+static WhitespaceScan scalar_skip_whitespace(const char* src, uint32_t pos, uint32_t end) {
+    WhitespaceScan ws = {pos, 0, 0};
+    for (; ws.end < end; ws.end++) {
+        char c = src[ws.end];
+        if (c == '\n') {
+            ws.newlines++;
+            ws.line_start = ws.end + 1;
+        } else if (c != ' ' && c != '\t') {
+            break;
+        }
+    }
+    return ws;
+}
+
+static uint32_t scalar_skip_ident(const char* src, uint32_t pos, uint32_t end) {
+    while (pos < end && is_ident_char(src[pos])) pos++;
+    return pos;
+}
+
+static uint32_t scalar_skip_digits(const char* src, uint32_t pos, uint32_t end) {
+    while (pos < end && src[pos] >= '0' && src[pos] <= '9') pos++;
+    return pos;
+}
+
+static uint32_t scalar_find_string_end(const char* src, uint32_t pos, uint32_t end) {
+    while (pos < end && src[pos] != '"' && src[pos] != '\\') pos++;
+    return pos;
+}
+
+static Utf8Scan scalar_validate_utf8(const char* src, uint32_t pos, uint32_t end) {
+    Utf8Scan scan = {end, true};
+    while (pos < end) {
+        // 8 ASCII bytes at a time
+        uint64_t word;
+        if (pos + 8 <= end) {
+            memcpy(&word, src + pos, 8);
+            if (!(word & 0x8080808080808080)) {
+                pos += 8;
+                continue;
+            }
+        }
+        if ((uint8_t)src[pos] < 0x80) {
+            pos++;
+            continue;
+        }
+        scan.ascii = false;
+        CodePoint cp = decode_utf8(src + pos);
+        if (!cp.len || pos + cp.len > end) {
+            scan.error = pos;
+            return scan;
+        }
+        pos += cp.len;
+    }
+    return scan;
+}
+
+static const ScanKernels scalar_kernels = {
+    Scan_Scalar,
+    scalar_skip_whitespace,
+    scalar_skip_ident,
+    scalar_skip_digits,
+    scalar_find_string_end,
+    scalar_validate_utf8,
+};
+
+#if SCAN_X86
+
+// Range checks use the signed compare trick: c + (0x80 - lo) maps [lo, hi] onto
+// [-128, hi - lo - 128], so one cmpgt tells us which bytes fall outside of it.
+
+//
+// SSE2, 16 bytes per step
+//
+
+static inline uint32_t sse2_in_range(__m128i v, char lo, char hi) {
+    __m128i shifted = _mm_add_epi8(v, _mm_set1_epi8((char)(0x80 - lo)));
+    __m128i outside = _mm_cmpgt_epi8(shifted, _mm_set1_epi8((char)(hi - lo - 0x80)));
+    return ~(uint32_t)_mm_movemask_epi8(outside) & 0xFFFF;
+}
+
+static inline uint32_t sse2_eq(__m128i v, char c) {
+    return (uint32_t)_mm_movemask_epi8(_mm_cmpeq_epi8(v, _mm_set1_epi8(c)));
+}
+
+static WhitespaceScan sse2_skip_whitespace(const char* src, uint32_t pos, uint32_t end) {
+    WhitespaceScan ws = {pos, 0, 0};
+    while (ws.end + 16 <= end) {
+        __m128i v = _mm_loadu_si128((const __m128i*)(src + ws.end));
+        uint32_t newline = sse2_eq(v, '\n');
+        uint32_t other = ~(newline | sse2_eq(v, ' ') | sse2_eq(v, '\t')) & 0xFFFF;
+        if (other) newline &= (1u << __builtin_ctz(other)) - 1;
+        if (newline) {
+            ws.newlines += __builtin_popcount(newline);
+            ws.line_start = ws.end + 32 - __builtin_clz(newline);
+        }
+        if (other) {
+            ws.end += __builtin_ctz(other);
+            return ws;
+        }
+        ws.end += 16;
+    }
+    WhitespaceScan tail = scalar_skip_whitespace(src, ws.end, end);
+    if (tail.newlines) {
+        ws.newlines += tail.newlines;
+        ws.line_start = tail.line_start;
+    }
+    ws.end = tail.end;
+    return ws;
+}
+
+static uint32_t sse2_skip_ident(const char* src, uint32_t pos, uint32_t end) {
+    while (pos + 16 <= end) {
+        __m128i v = _mm_loadu_si128((const __m128i*)(src + pos));
+        // setting bit 5 folds upper case onto lower case without touching digits or '_'
+        __m128i lower = _mm_or_si128(v, _mm_set1_epi8(0x20));
+        uint32_t ident =
+            sse2_in_range(lower, 'a', 'z') | sse2_in_range(v, '0', '9') | sse2_eq(v, '_');
+        uint32_t other = ~ident & 0xFFFF;
+        if (other) return pos + __builtin_ctz(other);
+        pos += 16;
+    }
+    return scalar_skip_ident(src, pos, end);
+}
+
+static uint32_t sse2_skip_digits(const char* src, uint32_t pos, uint32_t end) {
+    while (pos + 16 <= end) {
+        __m128i v = _mm_loadu_si128((const __m128i*)(src + pos));
+        uint32_t other = ~sse2_in_range(v, '0', '9') & 0xFFFF;
+        if (other) return pos + __builtin_ctz(other);
+        pos += 16;
+    }
+    return scalar_skip_digits(src, pos, end);
+}
+
+static uint32_t sse2_find_string_end(const char* src, uint32_t pos, uint32_t end) {
+    while (pos + 16 <= end) {
+        __m128i v = _mm_loadu_si128((const __m128i*)(src + pos));
+        uint32_t special = sse2_eq(v, '"') | sse2_eq(v, '\\');
+        if (special) return pos + __builtin_ctz(special);
+        pos += 16;
+    }
+    return scalar_find_string_end(src, pos, end);
+}
+
+// SSE2 has no byte shuffle for the table lookups the AVX2 version uses, so it only
+// skips ASCII 16 bytes at a time and decodes the non ASCII runs one by one
+static Utf8Scan sse2_validate_utf8(const char* src, uint32_t pos, uint32_t end) {
+    bool ascii = true;
+    while (pos + 16 <= end) {
+        __m128i v = _mm_loadu_si128((const __m128i*)(src + pos));
+        uint32_t high = (uint32_t)_mm_movemask_epi8(v);
+        if (!high) {
+            pos += 16;
+            continue;
+        }
+        ascii = false;
+        pos += __builtin_ctz(high);
+        while (pos < end && (uint8_t)src[pos] >= 0x80) {
+            CodePoint cp = decode_utf8(src + pos);
+            if (!cp.len || pos + cp.len > end) return {pos, false};
+            pos += cp.len;
+        }
+    }
+    Utf8Scan tail = scalar_validate_utf8(src, pos, end);
+    tail.ascii &= ascii;
+    return tail;
+}
+
+static const ScanKernels sse2_kernels = {
+    Scan_SSE2,
+    sse2_skip_whitespace,
+    sse2_skip_ident,
+    sse2_skip_digits,
+    sse2_find_string_end,
+    sse2_validate_utf8,
+};
+
+//
+// AVX2, 32 bytes per step
+//
+
+#define AVX2 __attribute__((target("avx2")))
+
+AVX2 static inline uint32_t avx2_in_range(__m256i v, char lo, char hi) {
+    __m256i shifted = _mm256_add_epi8(v, _mm256_set1_epi8((char)(0x80 - lo)));
+    __m256i outside = _mm256_cmpgt_epi8(shifted, _mm256_set1_epi8((char)(hi - lo - 0x80)));
+    return ~(uint32_t)_mm256_movemask_epi8(outside);
+}
+
+AVX2 static inline uint32_t avx2_eq(__m256i v, char c) {
+    return (uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi8(v, _mm256_set1_epi8(c)));
+}
+
+AVX2 static WhitespaceScan avx2_skip_whitespace(const char* src, uint32_t pos, uint32_t end) {
+    WhitespaceScan ws = {pos, 0, 0};
+    while (ws.end + 32 <= end) {
+        __m256i v = _mm256_loadu_si256((const __m256i*)(src + ws.end));
+        uint32_t newline = avx2_eq(v, '\n');
+        uint32_t other = ~(newline | avx2_eq(v, ' ') | avx2_eq(v, '\t'));
+        if (other) newline &= (uint32_t)((1ull << __builtin_ctz(other)) - 1);
+        if (newline) {
+            ws.newlines += __builtin_popcount(newline);
+            ws.line_start = ws.end + 32 - __builtin_clz(newline);
+        }
+        if (other) {
+            ws.end += __builtin_ctz(other);
+            return ws;
+        }
+        ws.end += 32;
+    }
+    WhitespaceScan tail = sse2_skip_whitespace(src, ws.end, end);
+    if (tail.newlines) {
+        ws.newlines += tail.newlines;
+        ws.line_start = tail.line_start;
+    }
+    ws.end = tail.end;
+    return ws;
+}
+
+AVX2 static uint32_t avx2_skip_ident(const char* src, uint32_t pos, uint32_t end) {
+    while (pos + 32 <= end) {
+        __m256i v = _mm256_loadu_si256((const __m256i*)(src + pos));
+        __m256i lower = _mm256_or_si256(v, _mm256_set1_epi8(0x20));
+        uint32_t ident =
+            avx2_in_range(lower, 'a', 'z') | avx2_in_range(v, '0', '9') | avx2_eq(v, '_');
+        if (~ident) return pos + __builtin_ctz(~ident);
+        pos += 32;
+    }
+    return sse2_skip_ident(src, pos, end);
+}
+
+AVX2 static uint32_t avx2_skip_digits(const char* src, uint32_t pos, uint32_t end) {
+    while (pos + 32 <= end) {
+        __m256i v = _mm256_loadu_si256((const __m256i*)(src + pos));
+        uint32_t other = ~avx2_in_range(v, '0', '9');
+        if (other) return pos + __builtin_ctz(other);
+        pos += 32;
+    }
+    return sse2_skip_digits(src, pos, end);
+}
+
+AVX2 static uint32_t avx2_find_string_end(const char* src, uint32_t pos, uint32_t end) {
+    while (pos + 32 <= end) {
+        __m256i v = _mm256_loadu_si256((const __m256i*)(src + pos));
+        uint32_t special = avx2_eq(v, '"') | avx2_eq(v, '\\');
+        if (special) return pos + __builtin_ctz(special);
+        pos += 32;
+    }
+    return sse2_find_string_end(src, pos, end);
+}
+
+// UTF-8 validation with three nibble lookups per 32 bytes (Keiser & Lemire, "Validating
+// UTF-8 In Less Than One Instruction Per Byte"). Every error is a property of a byte and
+// the one before it, except for missing or extra continuation bytes in 3/4 byte sequences
+// which need the bytes 2 and 3 back.
+
+enum : uint8_t {
+    Utf8_TooShort = 1 << 0,   // lead byte not followed by a continuation
+    Utf8_TooLong = 1 << 1,    // continuation after ASCII
+    Utf8_Overlong3 = 1 << 2,  // 11100000 100_____
+    Utf8_TooLarge = 1 << 3,   // past U+10FFFF
+    Utf8_Surrogate = 1 << 4,  // 11101101 101_____
+    Utf8_Overlong2 = 1 << 5,  // 1100000_ 10______
+    Utf8_TooLarge1000 = 1 << 6,
+    Utf8_Overlong4 = 1 << 6,  // 11110000 1000____
+    Utf8_TwoConts = 1 << 7,   // continuation after continuation, fine if it's byte 3 or 4
+    Utf8_Carry = Utf8_TooShort | Utf8_TooLong | Utf8_TwoConts,
+};
+
+// the same 16 byte table in both 128 bit lanes
+#define BOTH_LANES(...) __VA_ARGS__, __VA_ARGS__
+
+// the last n bytes of `prev` followed by the first 32 - n of `input`
+#define AVX2_PREV(input, prev, n)                                                                  \
+    _mm256_alignr_epi8(input, _mm256_permute2x128_si256(prev, input, 0x21), 16 - (n))
+
+AVX2 static inline __m256i avx2_utf8_errors(__m256i input, __m256i prev_input) {
+    const __m256i byte_1_high_table = _mm256_setr_epi8(BOTH_LANES(
+        // 0___ ASCII
+        Utf8_TooLong, Utf8_TooLong, Utf8_TooLong, Utf8_TooLong, Utf8_TooLong, Utf8_TooLong,
+        Utf8_TooLong, Utf8_TooLong,
+        // 10__ continuation
+        Utf8_TwoConts, Utf8_TwoConts, Utf8_TwoConts, Utf8_TwoConts,
+        // 1100, 1101 two byte lead
+        Utf8_TooShort | Utf8_Overlong2, Utf8_TooShort,
+        // 1110 three byte lead
+        Utf8_TooShort | Utf8_Overlong3 | Utf8_Surrogate,
+        // 1111 four byte lead
+        Utf8_TooShort | Utf8_TooLarge | Utf8_TooLarge1000 | Utf8_Overlong4));
+    const __m256i byte_1_low_table = _mm256_setr_epi8(BOTH_LANES(
+        Utf8_Carry | Utf8_Overlong3 | Utf8_Overlong2 | Utf8_Overlong4, // ____0000
+        Utf8_Carry | Utf8_Overlong2,                                   // ____0001
+        Utf8_Carry, Utf8_Carry,                                        // ____001_
+        Utf8_Carry | Utf8_TooLarge,                                    // ____0100
+        Utf8_Carry | Utf8_TooLarge | Utf8_TooLarge1000,                // ____0101
+        Utf8_Carry | Utf8_TooLarge | Utf8_TooLarge1000,                // ____011_
+        Utf8_Carry | Utf8_TooLarge | Utf8_TooLarge1000,
+        Utf8_Carry | Utf8_TooLarge | Utf8_TooLarge1000, // ____1___
+        Utf8_Carry | Utf8_TooLarge | Utf8_TooLarge1000,
+        Utf8_Carry | Utf8_TooLarge | Utf8_TooLarge1000,
+        Utf8_Carry | Utf8_TooLarge | Utf8_TooLarge1000,
+        Utf8_Carry | Utf8_TooLarge | Utf8_TooLarge1000,
+        Utf8_Carry | Utf8_TooLarge | Utf8_TooLarge1000 | Utf8_Surrogate, // ____1101
+        Utf8_Carry | Utf8_TooLarge | Utf8_TooLarge1000,
+        Utf8_Carry | Utf8_TooLarge | Utf8_TooLarge1000));
+    const __m256i byte_2_high_table = _mm256_setr_epi8(BOTH_LANES(
+        // 0___ ASCII
+        Utf8_TooShort, Utf8_TooShort, Utf8_TooShort, Utf8_TooShort, Utf8_TooShort,
+        Utf8_TooShort, Utf8_TooShort, Utf8_TooShort,
+        // 1000
+        Utf8_TooLong | Utf8_Overlong2 | Utf8_TwoConts | Utf8_Overlong3 | Utf8_TooLarge1000 |
+            Utf8_Overlong4,
+        // 1001
+        Utf8_TooLong | Utf8_Overlong2 | Utf8_TwoConts | Utf8_Overlong3 | Utf8_TooLarge,
+        // 101_
+        Utf8_TooLong | Utf8_Overlong2 | Utf8_TwoConts | Utf8_Surrogate | Utf8_TooLarge,
+        Utf8_TooLong | Utf8_Overlong2 | Utf8_TwoConts | Utf8_Surrogate | Utf8_TooLarge,
+        // 11__ lead
+        Utf8_TooShort, Utf8_TooShort, Utf8_TooShort, Utf8_TooShort));
+
+    const __m256i low_nibble = _mm256_set1_epi8(0x0F);
+    __m256i prev1 = AVX2_PREV(input, prev_input, 1);
+    __m256i byte_1_high = _mm256_shuffle_epi8(
+        byte_1_high_table, _mm256_and_si256(_mm256_srli_epi16(prev1, 4), low_nibble));
+    __m256i byte_1_low = _mm256_shuffle_epi8(byte_1_low_table, _mm256_and_si256(prev1, low_nibble));
+    __m256i byte_2_high = _mm256_shuffle_epi8(
+        byte_2_high_table, _mm256_and_si256(_mm256_srli_epi16(input, 4), low_nibble));
+    __m256i special = _mm256_and_si256(_mm256_and_si256(byte_1_high, byte_1_low), byte_2_high);
+
+    // bytes 2 and 3 after a 3 / 4 byte lead must be continuations, the lookups above
+    // flagged them as TwoConts, so the two cancel out
+    __m256i prev2 = AVX2_PREV(input, prev_input, 2);
+    __m256i prev3 = AVX2_PREV(input, prev_input, 3);
+    __m256i third = _mm256_subs_epu8(prev2, _mm256_set1_epi8((char)(0xE0 - 0x80)));
+    __m256i fourth = _mm256_subs_epu8(prev3, _mm256_set1_epi8((char)(0xF0 - 0x80)));
+    __m256i must_be_cont =
+        _mm256_and_si256(_mm256_or_si256(third, fourth), _mm256_set1_epi8((char)0x80));
+    return _mm256_xor_si256(must_be_cont, special);
+}
+
+AVX2 static Utf8Scan avx2_validate_utf8(const char* src, uint32_t pos, uint32_t end) {
+    // a lead byte in the last 1 / 2 / 3 positions still waits for continuations
+    const __m256i incomplete_max =
+        _mm256_setr_epi8(-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+                         -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, (char)(0xF0 - 1),
+                         (char)(0xE0 - 1), (char)(0xC0 - 1));
+    uint32_t start = pos;
+    bool ascii = true;
+    __m256i error = _mm256_setzero_si256();
+    __m256i prev_input = _mm256_setzero_si256();
+    __m256i prev_incomplete = _mm256_setzero_si256();
+    while (pos < end) {
+        __m256i input;
+        if (pos + 32 <= end) {
+            input = _mm256_loadu_si256((const __m256i*)(src + pos));
+        } else {
+            // zeros after the end, a sequence cut off by them is too short
+            alignas(32) char tail[32] = {};
+            memcpy(tail, src + pos, end - pos);
+            input = _mm256_load_si256((const __m256i*)tail);
+        }
+        if (!_mm256_movemask_epi8(input)) {
+            error = _mm256_or_si256(error, prev_incomplete);
+            prev_incomplete = _mm256_setzero_si256();
+        } else {
+            ascii = false;
+            error = _mm256_or_si256(error, avx2_utf8_errors(input, prev_input));
+            prev_incomplete = _mm256_subs_epu8(input, incomplete_max);
+        }
+        prev_input = input;
+        pos += 32;
+    }
+    error = _mm256_or_si256(error, prev_incomplete);
+    // the vector code only knows that something is wrong, let the scalar one find where
+    if (!_mm256_testz_si256(error, error)) return scalar_validate_utf8(src, start, end);
+    return {end, ascii};
+}
+
+#undef AVX2_PREV
+#undef BOTH_LANES
+#undef AVX2
+
+static const ScanKernels avx2_kernels = {
+    Scan_AVX2,
+    avx2_skip_whitespace,
+    avx2_skip_ident,
+    avx2_skip_digits,
+    avx2_find_string_end,
+    avx2_validate_utf8,
+};
+
+#endif // SCAN_X86
+
+static auto kernels_for(ScanPath path) -> const ScanKernels* {
+    switch (path) {
+    case Scan_Scalar:
+        return &scalar_kernels;
+#if SCAN_X86
+    case Scan_SSE2:
+        return &sse2_kernels;
+    case Scan_AVX2:
+        return &avx2_kernels;
+#else
+    default:
+        break;
+#endif
+    }
+    return nullptr;
+}
+
+auto scan_path_supported(ScanPath path) -> bool {
+    switch (path) {
+    case Scan_Scalar:
+        return true;
+#if SCAN_X86
+    case Scan_SSE2:
+        return __builtin_cpu_supports("sse2");
+    case Scan_AVX2:
+        return __builtin_cpu_supports("avx2");
+#else
+    default:
+        break;
+#endif
+    }
+    return false;
+}
+
+static auto best_kernels() -> const ScanKernels* {
+#if SCAN_X86
+    // we run from a static initializer, possibly before libgcc filled the cpu model
+    __builtin_cpu_init();
+#endif
+    if (scan_path_supported(Scan_AVX2)) return kernels_for(Scan_AVX2);
+    if (scan_path_supported(Scan_SSE2)) return kernels_for(Scan_SSE2);
+    return kernels_for(Scan_Scalar);
+}
+
+const ScanKernels* scan_kernels = best_kernels();
+
+auto scan_use_path(ScanPath path) -> bool {
+    if (!scan_path_supported(path)) return false;
+    scan_kernels = kernels_for(path);
+    return true;
+}
+
+auto enum_to_str(ScanPath path) -> const char* {
+    switch (path) {
+    case Scan_Scalar:
+        return "Scalar";
+    case Scan_SSE2:
+        return "SSE2";
+    case Scan_AVX2:
+        return "AVX2";
+    }
+    return "";
+}
@@ -0,0 +1,41 @@
+#pragma once
+#include <stdint.h>
+
+// Character class kernels used by the lexer hot loops.
+// Each kernel starts at `pos` and returns the first byte in [pos, end) that is not
+// part of its class (or `end`), reading 16 / 32 bytes at a time when the cpu allows it.
+
+enum ScanPath {
+    Scan_Scalar,
+    Scan_SSE2,
+    Scan_AVX2,
+};
+
+struct WhitespaceScan {
+    uint32_t end;        // first non whitespace byte
+    uint32_t newlines;   // newlines skipped on the way
+    uint32_t line_start; // byte after the last skipped newline, only valid if newlines > 0
+};
+
+struct Utf8Scan {
+    uint32_t error; // first byte of the first invalid sequence, `end` if there is none
+    bool ascii;     // no byte >= 0x80 at all
+};
+
+struct ScanKernels {
+    ScanPath path;
+    WhitespaceScan (*skip_whitespace)(const char* src, uint32_t pos, uint32_t end);
+    uint32_t (*skip_ident)(const char* src, uint32_t pos, uint32_t end);      // [a-zA-Z0-9_]
+    uint32_t (*skip_digits)(const char* src, uint32_t pos, uint32_t end);     // [0-9]
+    uint32_t (*find_string_end)(const char* src, uint32_t pos, uint32_t end); // '"' or '\\'
+    // `pos` must be on a character boundary
+    Utf8Scan (*validate_utf8)(const char* src, uint32_t pos, uint32_t end);
+};
+
+// the best path the running cpu supports, picked once at startup
+extern const ScanKernels* scan_kernels;
+
+auto scan_path_supported(ScanPath path) -> bool;
+// switch the kernels used by the lexer, returns false if the cpu can't run them
+auto scan_use_path(ScanPath path) -> bool;
+auto enum_to_str(ScanPath path) -> const char*;
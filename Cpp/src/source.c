@@ -0,0 +1,138 @@
+#include "source.h"
+#include "diagnostics.h"
+#include "scan.h"
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+static auto round_to_pages(size_t size) -> size_t {
+    size_t page = (size_t)sysconf(_SC_PAGESIZE);
+    return (size + page - 1) / page * page;
+}
+
+// anonymous pages are zero filled, which is where the padding comes from
+static auto map_zeroed(size_t size, int prot) -> char* {
+    void* ptr = mmap(nullptr, size, prot, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (ptr == MAP_FAILED) {
+        print_error("couldn't map %zu bytes", size);
+    }
+    return (char*)ptr;
+}
+
+static auto check_size(const char* file_name, size_t size) -> uint32_t {
+    if (size > UINT32_MAX - source_padding) {
+        print_error("file %s is too big (%zu bytes)", file_name, size);
+    }
+    return (uint32_t)size;
+}
+
+// The file is mapped over the front of a zeroed reservation that is at least
+// source_padding bytes longer, the tail of its last page is zero filled by the kernel.
+static auto map_regular_file(const char* file_name, int fd, size_t size) -> SourceBuffer {
+    size_t mapped_size = round_to_pages(size + source_padding);
+    char* base = map_zeroed(mapped_size, PROT_READ);
+    if (size > 0) {
+        void* file = mmap(base, size, PROT_READ, MAP_PRIVATE | MAP_FIXED, fd, 0);
+        if (file == MAP_FAILED) {
+            print_error("couldn't mmap file %s", file_name);
+        }
+        madvise(base, size, MADV_SEQUENTIAL);
+    }
+    return SourceBuffer(base, check_size(file_name, size), mapped_size);
+}
+
+// pipes, ttys and friends can't be mapped, read them until eof instead
+static auto read_stream(const char* file_name, int fd) -> SourceBuffer {
+    size_t capacity = round_to_pages(64 * 1024);
+    size_t size = 0;
+    char* buf = map_zeroed(capacity, PROT_READ | PROT_WRITE);
+    while (true) {
+        if (capacity - size < source_padding) {
+            size_t new_capacity = capacity * 2;
+            char* grown = (char*)mremap(buf, capacity, new_capacity, MREMAP_MAYMOVE);
+            if (grown == MAP_FAILED) {
+                print_error("couldn't grow buffer for %s", file_name);
+            }
+            buf = grown;
+            capacity = new_capacity;
+        }
+        ssize_t n = read(fd, buf + size, capacity - size - source_padding);
+        if (n == 0) break;
+        if (n < 0) {
+            print_error("couldn't read %s", file_name);
+        }
+        size += (size_t)n;
+    }
+    mprotect(buf, capacity, PROT_READ);
+    return SourceBuffer(buf, check_size(file_name, size), capacity);
+}
+
+auto read_file(const char* file_name, std::string* error) -> SourceBuffer {
+    bool is_stdin = strcmp(file_name, "-") == 0;
+    int fd = is_stdin ? STDIN_FILENO : open(file_name, O_RDONLY);
+    if (fd < 0) {
+        *error = std::string(file_name) + ": couldn't open the file";
+        return SourceBuffer();
+    }
+
+    struct stat st;
+    SourceBuffer buf;
+    if (fstat(fd, &st) == 0 && S_ISREG(st.st_mode)) {
+        if ((size_t)st.st_size > UINT32_MAX - source_padding) {
+            close(fd);
+            *error = std::string(file_name) + ": too big (" + std::to_string(st.st_size) +
+                     " bytes)";
+            return SourceBuffer();
+        }
+        buf = map_regular_file(file_name, fd, (size_t)st.st_size);
+    } else {
+        buf = read_stream(file_name, fd);
+    }
+    if (!is_stdin) close(fd);
+
+    // one pass over the whole file, the lexer can then trust every multi byte sequence
+    Utf8Scan utf8 = scan_kernels->validate_utf8(buf.data, 0, buf.size);
+    if (utf8.error != buf.size) {
+        uint32_t line = 1, line_start = 0;
+        for (uint32_t i = 0; i < utf8.error; i++) {
+            if (buf.data[i] == '\n') line++, line_start = i + 1;
+        }
+        char text[64];
+        snprintf(text, sizeof(text), ":%u:%u: invalid UTF-8 (byte 0x%02X)", line,
+                 utf8.error - line_start + 1, (uint8_t)buf.data[utf8.error]);
+        *error = file_name;
+        *error += text;
+        return SourceBuffer();
+    }
+    return buf;
+}
+
+auto read_file(const char* file_name) -> SourceBuffer {
+    std::string error;
+    SourceBuffer buf = read_file(file_name, &error);
+    if (!error.empty()) {
+        print_error("%s", error.c_str());
+    }
+    return buf;
+}
+
+SourceBuffer::~SourceBuffer() {
+    if (mapped_size) munmap((void*)data, mapped_size);
+}
+
+SourceBuffer& SourceBuffer::operator=(SourceBuffer&& other) {
+    if (this != &other) {
+        if (mapped_size) munmap((void*)data, mapped_size);
+        data = other.data;
+        size = other.size;
+        mapped_size = other.mapped_size;
+        other.data = nullptr;
+        other.size = 0;
+        other.mapped_size = 0;
+    }
+    return *this;
+}
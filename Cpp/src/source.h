@@ -0,0 +1,61 @@
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+#include <string>
+#include <string_view>
+
+// Every source buffer is followed by at least this many zero bytes, so the scan
+// kernels (and peek()) can read past the last byte without faulting.
+constexpr uint32_t source_padding = 64;
+
+// Read only file contents. Regular files are mmapped straight from the page cache,
+// pipes and stdin ("-") are read into an anonymous mapping of the same shape.
+struct SourceBuffer {
+    const char* data = nullptr;
+    uint32_t size = 0;
+
+    SourceBuffer() {}
+    SourceBuffer(const char* _data, uint32_t _size, size_t _mapped_size)
+        : data(_data), size(_size), mapped_size(_mapped_size) {}
+    ~SourceBuffer();
+
+    SourceBuffer(const SourceBuffer&) = delete;
+    SourceBuffer& operator=(const SourceBuffer&) = delete;
+    SourceBuffer(SourceBuffer&& other) { *this = static_cast<SourceBuffer&&>(other); }
+    SourceBuffer& operator=(SourceBuffer&& other);
+
+    auto view() const -> std::string_view { return {data, size}; }
+    operator std::string_view() const { return view(); }
+
+  private:
+    size_t mapped_size = 0;
+};
+
+// exits with an error message (and status 1) if the file can't be read or isn't valid
+// UTF-8, "-" reads stdin
+auto read_file(const char* file_name) -> SourceBuffer;
+// same, for tools going through many files: the message, starting with the file name,
+// goes to `error` and an empty buffer comes back
+auto read_file(const char* file_name, std::string* error) -> SourceBuffer;
+
+// A text change as reported by an editor: `removed` bytes at `offset` were replaced
+// by `inserted`.
+struct SourceEdit {
+    uint32_t offset;
+    uint32_t removed;
+    std::string_view inserted;
+};
+
+// In memory source that can be edited, keeps the source_padding zero bytes behind
+// the text so its view() can be handed to the Lexer like a SourceBuffer.
+struct EditableSource {
+    std::string text;
+
+    EditableSource(std::string_view contents) : text(contents) {
+        text.append(source_padding, '\0');
+    }
+
+    auto size() const -> uint32_t { return text.size() - source_padding; }
+    auto view() const -> std::string_view { return {text.data(), size()}; }
+    void apply(const SourceEdit& edit) { text.replace(edit.offset, edit.removed, edit.inserted); }
+};
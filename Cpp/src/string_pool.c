@@ -0,0 +1,81 @@
+#include "string_pool.h"
+
+StringPool string_pool;
+
+static inline int hex_value(char c) {
+    if (c >= '0' && c <= '9') return c - '0';
+    c |= 0x20;
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    return -1;
+}
+
+static void append_utf8(std::string* out, uint32_t cp) {
+    char buf[4];
+    uint32_t len;
+    if (cp < 0x80) {
+        buf[0] = (char)cp;
+        len = 1;
+    } else if (cp < 0x800) {
+        buf[0] = (char)(0xC0 | cp >> 6);
+        buf[1] = (char)(0x80 | (cp & 0x3F));
+        len = 2;
+    } else if (cp < 0x10000) {
+        buf[0] = (char)(0xE0 | cp >> 12);
+        buf[1] = (char)(0x80 | (cp >> 6 & 0x3F));
+        buf[2] = (char)(0x80 | (cp & 0x3F));
+        len = 3;
+    } else {
+        buf[0] = (char)(0xF0 | cp >> 18);
+        buf[1] = (char)(0x80 | (cp >> 12 & 0x3F));
+        buf[2] = (char)(0x80 | (cp >> 6 & 0x3F));
+        buf[3] = (char)(0x80 | (cp & 0x3F));
+        len = 4;
+    }
+    out->append(buf, len);
+}
+
+auto decode_escape(const char* p, std::string* out) -> uint32_t {
+    char c;
+    switch (p[1]) {
+    case 'n':
+        c = '\n';
+        break;
+    case 't':
+        c = '\t';
+        break;
+    case 'r':
+        c = '\r';
+        break;
+    case '0':
+        c = '\0';
+        break;
+    case '\\':
+        c = '\\';
+        break;
+    case '"':
+        c = '"';
+        break;
+    case '\'':
+        c = '\'';
+        break;
+    case 'x': {
+        int hi = hex_value(p[2]), lo = hex_value(p[3]);
+        if (hi < 0 || lo < 0) return 0;
+        if (out) out->push_back((char)(hi << 4 | lo));
+        return 4;
+    }
+    case 'u': {
+        if (p[2] != '{') return 0;
+        uint32_t cp = 0, i = 3;
+        for (; hex_value(p[i]) >= 0 && i < 9; i++) cp = cp << 4 | hex_value(p[i]);
+        if (i == 3 || p[i] != '}') return 0;
+        if (cp > 0x10FFFF || (cp >= 0xD800 && cp < 0xE000)) return 0;
+        if (out) append_utf8(out, cp);
+        return i + 1;
+    }
+    default:
+        return 0;
+    }
+    if (out) out->push_back(c);
+    return 2;
+}
@@ -0,0 +1,17 @@
+#pragma once
+#include "intern.h"
+#include <string>
+
+using StringId = SymbolId;
+
+// Decoded string literals, deduplicated by content: the same literal in two functions
+// or two files is one entry with one id. Kept apart from identifier_pool so string
+// contents and names never share ids.
+using StringPool = Interner;
+
+extern StringPool string_pool;
+
+// Decodes the escape sequence starting at the '\' in `p`: \n \t \r \0 \\ \" \'
+// \xHH and \u{H..HHHHHH}. Appends the bytes to `out` (if any) and returns how many
+// source bytes it used, 0 for an unknown or malformed escape.
+auto decode_escape(const char* p, std::string* out) -> uint32_t;
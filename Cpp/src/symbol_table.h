@@ -1,4 +1,5 @@
 #pragma once
+#include "intern.h"
 #include "type.h"
 #include <map>
 #include <stdint.h>
@@ -7,7 +8,7 @@
 using std::vector, std::string, std::map;
 
 struct Symbol {
-    string name;
+    SymbolId name; // from identifier_pool, compare names by id
     Type type;
 
     union {
@@ -1,65 +1,115 @@
 #include "tree.h"
 
-auto enum_to_str(NodeKind kind) -> const char* {
-#define case_to_str(T) case T:return &((#T)[4])
-    switch (kind) {
-        case_to_str(Ast_None);
-        case_to_str(Ast_Root);
-        case_to_str(Ast_Identifier);
-        case_to_str(Ast_StringLiteral);
-        case_to_str(Ast_NumberLiteral);
-        case_to_str(Ast_NullLiteral);
-		case_to_str(Ast_IncludeStmt);
-		case_to_str(Ast_MacroDefine);
-        case_to_str(Ast_Mul);
-        case_to_str(Ast_Add);
-        case_to_str(Ast_Sub);
-        case_to_str(Ast_Div);
-        case_to_str(Ast_Bool_Not);
-        case_to_str(Ast_Bool_Or);
-        case_to_str(Ast_Bool_And);
-        case_to_str(Ast_Bit_Not);
-        case_to_str(Ast_Bit_Xor);
-        case_to_str(Ast_Bit_And);
-        case_to_str(Ast_Bit_Or);
-        case_to_str(Ast_ShiftLeft);
-        case_to_str(Ast_ShiftRight);
-        case_to_str(Ast_AddressOf);
-        case_to_str(Ast_Slice);
-        case_to_str(Ast_SliceSentinel);
-        case_to_str(Ast_SliceOpen);
-        case_to_str(Ast_Assign);
-        case_to_str(Ast_ArrayAccess);
-        case_to_str(Ast_FieldAccess);
-        case_to_str(Ast_Negation);
-        case_to_str(Ast_FnProto);
-        case_to_str(Ast_FnDecl);
-        case_to_str(Ast_VarDecl);
-        case_to_str(Ast_ConstDecl);
-        case_to_str(Ast_Deref);
-        case_to_str(Ast_Macro);
-        case_to_str(Ast_ParamDecl);
-        case_to_str(Ast_ParamDeclList);
-        case_to_str(Ast_Block);
-        case_to_str(Ast_If_Simple);
-        case_to_str(Ast_If);
-        case_to_str(Ast_WhileLoop);
-        case_to_str(Ast_ForLoop);
-        case_to_str(Ast_SimpleLoop);
-        case_to_str(Ast_Struct);
-        case_to_str(Ast_Union);
-        case_to_str(Ast_TypeName);
-        case_to_str(Ast_DeclType);
-        case_to_str(Ast_Array);
-        case_to_str(Ast_Pointer);
-        case_to_str(Ast_Label);
-        case_to_str(Ast_LessThan);
-        case_to_str(Ast_GreaterThan);
-        case_to_str(Ast_EqualEqual);
-        case_to_str(Ast_NotEqual);
-        case_to_str(Ast_CallOne);
-        case_to_str(Ast_Call);
+#include "parser.h"
+
+// The pointer tree is only a view of parser.ast for printing, the classes in tree.h still
+// do the printing. Whether a node is a type or an expression depends on the slot it's in,
+// Ast_Identifier is both.
+namespace {
+struct TreeBuilder {
+    Parser& p;
+    const Ast& ast;
+
+    auto type(NodeIndex i) -> Type* {
+        if (!i) return nullptr;
+        NodeData data = ast.data(i);
+        Token tok = p.token_at(ast.main_token(i));
+        switch (ast.tag(i)) {
+        case Ast_Pointer:
+            return p.arena.make<Pointer>(type(data.lhs), tok);
+        case Ast_Array:
+            return p.arena.make<Array>(type(data.rhs), expr(data.lhs), tok);
+        default: {
+            Type* t = p.arena.make<Type>(ast.tag(i), tok);
+            t->symbol = data.lhs;
+            return t;
+        }
+        }
+    }
+
+    template <typename T> auto list(SubRange range) -> NodeList<T*> {
+        auto items = ast.list(range);
+        NodeList<T*> list = {p.arena.alloc_array<T*>(items.size()), (uint32_t)items.size()};
+        for (uint32_t k = 0; k < list.count; k++) list.items[k] = static_cast<T*>(stmt(items[k]));
+        return list;
     }
-#undef case_to_str
-    return "";
+
+    auto expr(NodeIndex i) -> Expr* { return static_cast<Expr*>(stmt(i)); }
+
+    auto stmt(NodeIndex i) -> Stmt* {
+        if (!i) return nullptr;
+        NodeKind tag = ast.tag(i);
+        NodeData data = ast.data(i);
+        TokenIndex main_token = ast.main_token(i);
+        switch (tag) {
+        case Ast_Identifier:
+        case Ast_StringLiteral:
+        case Ast_Bool_Not:
+        case Ast_Negation:
+        case Ast_Bit_Not:
+        case Ast_AddressOf:
+        case Ast_Error:
+        case Ast_LazyBody: {
+            Literal* lit = p.arena.make<Literal>(tag, p.token_at(main_token));
+            lit->value = data.lhs;
+            return lit;
+        }
+        case Ast_NumberLiteral:
+        case Ast_FloatLiteral: {
+            Literal* lit = p.arena.make<Literal>(tag, p.token_at(main_token));
+            lit->value = ast.literal_value(i);
+            return lit;
+        }
+        case Ast_ParamDecl: {
+            ParamDecl* param = p.arena.make<ParamDecl>(p.token_at(main_token), type(data.lhs));
+            param->symbol = data.rhs;
+            return param;
+        }
+        case Ast_ParamDeclList:
+            return p.arena.make<ParamList>(list<Decl>({data.lhs, data.rhs}));
+        case Ast_Block:
+            return p.arena.make<Block>(list<Stmt>({data.lhs, data.rhs}));
+        case Ast_Call: {
+            auto args = list<Expr>(ast.extra<SubRange>(data.rhs));
+            CallExpr* call = p.arena.make<CallExpr>(p.token_at(main_token), args);
+            call->symbol = data.lhs;
+            return call;
+        }
+        case Ast_FnDecl: {
+            FnProto proto = ast.extra<FnProto>(data.lhs);
+            auto params = static_cast<ParamList*>(stmt(proto.params));
+            FnDecl* fn = p.arena.make<FnDecl>(p.token_at(main_token), params,
+                                              type(proto.return_type),
+                                              static_cast<Block*>(stmt(data.rhs)));
+            fn->symbol = proto.name;
+            return fn;
+        }
+        case Ast_VarDecl:
+        case Ast_ConstDecl: {
+            VarDeclInfo info = ast.extra<VarDeclInfo>(data.lhs);
+            Literal* name = p.arena.make<Literal>(Ast_Identifier, p.token_at(main_token));
+            name->value = info.name;
+            if (tag == Ast_VarDecl)
+                return p.arena.make<VarDecl>(name, type(info.type), expr(info.value));
+            return p.arena.make<ConstDecl>(name, type(info.type), expr(info.value));
+        }
+        case Ast_If_Simple:
+            return p.arena.make<IfStmt>(tag, expr(data.lhs), stmt(data.rhs));
+        case Ast_SimpleLoop:
+            return p.arena.make<LoopStmt>(tag, nullptr, nullptr, expr(data.lhs),
+                                          static_cast<Block*>(stmt(data.rhs)));
+        default:
+            // binary operators, Assign and FieldAccess
+            return p.arena.make<BinaryExpr>(tag, p.token_at(main_token), expr(data.lhs),
+                                            expr(data.rhs));
+        }
+    }
+};
+} // namespace
+
+auto Parser::debug_tree() -> vector<Stmt*> {
+    TreeBuilder builder = {*this, ast};
+    vector<Stmt*> list = {};
+    for (NodeIndex stmt : ast.list(0)) list.push_back(builder.stmt(stmt));
+    return list;
 }
@@ -1,71 +1,15 @@
 #pragma once
+#include "arena.h"
+#include "ast.h"
 #include "diagnostics.h"
 #include "lexer.h"
+#include "number.h"
 #include <cstdio>
 #include <stdlib.h>
 #include <string.h>
 
-enum NodeKind {
-    Ast_None,
-    Ast_Root,
-    Ast_Identifier,
-    Ast_StringLiteral,
-    Ast_NumberLiteral,
-    Ast_NullLiteral,
-    Ast_IncludeStmt,
-    Ast_MacroDefine,
-    Ast_Mul,
-    Ast_Add,
-    Ast_Sub,
-    Ast_Div,
-    Ast_Bool_Not,
-    Ast_Bool_Or,
-    Ast_Bool_And,
-    Ast_Bit_Not,
-    Ast_Bit_Xor,
-    Ast_Bit_And,
-    Ast_Bit_Or,
-    Ast_ShiftLeft,
-    Ast_ShiftRight,
-    Ast_AddressOf,
-    Ast_Slice,
-    Ast_SliceSentinel,
-    Ast_SliceOpen,
-    Ast_Assign,
-    Ast_ArrayAccess,
-    Ast_FieldAccess,
-    Ast_Negation,
-    Ast_FnProto,
-    Ast_FnDecl,
-    Ast_VarDecl,
-    Ast_ConstDecl,
-    Ast_Deref,
-    Ast_Macro,
-    Ast_ParamDecl,
-    Ast_ParamDeclList,
-    Ast_Block,
-    Ast_If_Simple,
-    Ast_If,
-    Ast_WhileLoop,
-    Ast_ForLoop,
-    Ast_SimpleLoop,
-    Ast_Struct,
-    Ast_Union,
-    Ast_TypeName,
-    Ast_DeclType,
-    Ast_Array,
-    Ast_Pointer,
-    Ast_Label,
-    Ast_LessThan,
-    Ast_GreaterThan,
-    Ast_EqualEqual,
-    Ast_NotEqual,
-    Ast_CallOne,
-    Ast_Call,
-};
-
-auto enum_to_str(NodeKind kind) -> const char*;
-
+// Nodes are allocated in the parser's Arena and freed with it, never one by one,
+// so they must stay trivially destructible (no std::vector or std::string members).
 struct Node {
     NodeKind kind;
     ~Node() = default;
@@ -99,17 +43,24 @@ struct Expr : Stmt {
 // string_literal , Identifier, number_literal , char_literal , struct_literal
 struct Literal : Expr {
     Token token;
+    uint64_t value = 0; // number and string literals decoded, identifiers interned by the lexer
+
+    auto int_value() const -> uint64_t { return value; }
+    auto float_value() const -> double { return bits_to_double(value); }
+    auto string_value() const -> string_view { return string_pool.get(value); }
+    // identifiers compare equal exactly when their symbols do
+    auto symbol() const -> SymbolId { return (SymbolId)value; }
 
     Literal(NodeKind _kind, Token tok) : Expr(_kind) { this->token = tok; }
 
     bool isLiteral() const override { return true; }
 
-    virtual string get_value() const override { return token.buf; }
+    virtual string get_value() const override { return string(token.buf); }
 
     void print(string prefix = "", bool isLeft = false) const override {
         printf("%s%s", prefix.c_str(), (isLeft ? "   " : "   "));
-        printf( "%s "  ":: %s\n", enum_to_str(this->kind),
-               token.buf.c_str());
+        printf( "%s "  ":: " SV_FMT "\n", enum_to_str(this->kind),
+               SV_ARG(token.buf));
     }
 };
 
@@ -131,8 +82,8 @@ struct BinaryExpr : Expr {
 
     void print(string prefix = "", bool isLeft = false) const override {
         printf("%s%s", prefix.c_str(), (isLeft ? "   " : "   "));
-        printf( "%s"  ":: %s\n", enum_to_str(this->kind),
-               token.buf.c_str());
+        printf( "%s"  ":: " SV_FMT "\n", enum_to_str(this->kind),
+               SV_ARG(token.buf));
 
         prefix += (isLeft ? "    " : "    ");
 
@@ -150,17 +101,21 @@ struct Slice : Expr {
 
 struct Type : Expr {
     Token token;
+    SymbolId symbol = no_symbol; // the name, for Ast_Identifier types
     Type() {}
-    Type(const Type& type) : Expr(type.kind) { this->token = type.token; }
+    Type(const Type& type) : Expr(type.kind) {
+        this->token = type.token;
+        this->symbol = type.symbol;
+    }
 
     Type(NodeKind _kind, Token name) : token(name) { this->kind = _kind; }
 
-    virtual const string toStr() const { return token.buf; }
+    virtual const string toStr() const { return string(token.buf); }
 
     void print(string prefix = "", bool isLeft = false) const override {
         printf("%s%s", prefix.c_str(), (isLeft ? "   " : "   "));
-        printf( "%s "  ":: %s\n", enum_to_str(this->kind),
-               token.buf.c_str());
+        printf( "%s "  ":: " SV_FMT "\n", enum_to_str(this->kind),
+               SV_ARG(token.buf));
     }
 };
 
@@ -175,12 +130,12 @@ struct Pointer : Type {
         this->base = base;
     }
 
-    const string toStr() const override { return string(token.buf + base->toStr()); }
+    const string toStr() const override { return string(token.buf) + base->toStr(); }
 
     void print(string prefix = "", bool isLeft = false) const override {
         printf("%s%s", prefix.c_str(), (isLeft ? "   " : "   "));
-        printf( "%s "  ":: %s\n", enum_to_str(this->kind),
-               token.buf.c_str());
+        printf( "%s "  ":: " SV_FMT "\n", enum_to_str(this->kind),
+               SV_ARG(token.buf));
 
         prefix += "    ";
        
@@ -246,6 +201,7 @@ struct Decl : Stmt {
 
 struct ParamDecl : Decl {
     Token token;
+    SymbolId symbol = no_symbol;
     ParamDecl(Token name, Type* _type) : Decl(Ast_ParamDecl, _type) {
         this->type = _type;
         this->kind = Ast_ParamDecl;
@@ -254,8 +210,8 @@ struct ParamDecl : Decl {
 
     void print(string prefix = "", bool isLeft = false) const override {
         printf("%s%s", prefix.c_str(), (isLeft ? "   " : "   "));
-        printf( "%s "  ":: %s\n", enum_to_str(this->kind),
-               token.buf.c_str());
+        printf( "%s "  ":: " SV_FMT "\n", enum_to_str(this->kind),
+               SV_ARG(token.buf));
 
         prefix += "    ";
        
@@ -266,8 +222,8 @@ struct ParamDecl : Decl {
 };
 
 struct ParamList : Stmt {
-    vector<Decl*> params;
-    ParamList(vector<Decl*> list) : Stmt(Ast_ParamDeclList) { this->params = list; }
+    NodeList<Decl*> params;
+    ParamList(NodeList<Decl*> list) : Stmt(Ast_ParamDeclList) { this->params = list; }
 
     void print(string prefix = "", bool isLeft = false) const override {
         printf("%s%s", prefix.c_str(), (isLeft ? "   " : "   "));
@@ -284,18 +240,19 @@ struct ParamList : Stmt {
 
 struct CallExpr : Expr {
     Token fn_name;
-    vector<Expr*> params;
+    SymbolId symbol = no_symbol;
+    NodeList<Expr*> params;
 
     CallExpr() : Expr(Ast_Call) {}
-    CallExpr(Token _name, vector<Expr*> parameters) : Expr(Ast_Call) {
+    CallExpr(Token _name, NodeList<Expr*> parameters) : Expr(Ast_Call) {
         this->fn_name = _name;
         this->params = parameters;
     }
 
     void print(string prefix = "", bool isLeft = false) const override {
         printf("%s%s", prefix.c_str(), (isLeft ? "   " : "   "));
-        printf( "%s "  ":: %s\n", enum_to_str(this->kind),
-               fn_name.buf.c_str());
+        printf( "%s "  ":: " SV_FMT "\n", enum_to_str(this->kind),
+               SV_ARG(fn_name.buf));
 
 
         prefix += "    ";
@@ -364,9 +321,9 @@ struct ConstDecl : Decl {
 };
 
 struct Block : Stmt {
-    vector<Stmt*> stmts;
+    NodeList<Stmt*> stmts;
     Block() : Stmt(Ast_Block) {}
-    Block(vector<Stmt*> copy_list) : Stmt(Ast_Block) { this->stmts = copy_list; }
+    Block(NodeList<Stmt*> list) : Stmt(Ast_Block) { this->stmts = list; }
 
     void print(string prefix = "", bool isLeft = false) const override {
         fflush(stdout);
@@ -420,6 +377,7 @@ struct IfStmt : Stmt {
 
 struct FnDecl : Decl {
     Token name;
+    SymbolId symbol = no_symbol;
     ParamList* params;
     Block* body;
 
@@ -428,6 +386,7 @@ struct FnDecl : Decl {
         this->body = nullptr;
     }
     FnDecl(Token _name, ParamList* parameter_decls, Type* ret_type, Block* body) {
+        this->kind = Ast_FnDecl;
         this->name = _name;
         this->params = parameter_decls;
         this->type = ret_type;
@@ -437,8 +396,8 @@ struct FnDecl : Decl {
     void print(string prefix = "", bool isLeft = false) const override {
         fflush(stdout);
         printf("%s%s", prefix.c_str(), (isLeft ? "   " : "   "));
-        printf( "%s"  ":: %s -> %s\n", enum_to_str(this->kind),
-               name.buf.c_str(), type->toStr().c_str());
+        printf( "%s"  ":: " SV_FMT " -> %s\n", enum_to_str(this->kind),
+               SV_ARG(name.buf), type->toStr().c_str());
 
         prefix += "    ";
 
@@ -0,0 +1,15 @@
+#include "unicode.h"
+#include "unicode_tables.h"
+
+// two level lookup: the high bits pick one of the deduplicated 256 code point blocks,
+// the low 8 bits a bit in its bitmap. ~12 KB for all of Unicode.
+static inline bool xid_bit(uint32_t cp, uint32_t which) {
+    uint32_t block = cp >> xid_block_shift;
+    if (block >= xid_block_count) return false;
+    const uint64_t* bits = xid_blocks[xid_block_index[block]] + which * 4;
+    uint32_t low = cp & 0xFF;
+    return bits[low >> 6] >> (low & 63) & 1;
+}
+
+auto is_xid_start(uint32_t cp) -> bool { return xid_bit(cp, 0); }
+auto is_xid_continue(uint32_t cp) -> bool { return xid_bit(cp, 1); }
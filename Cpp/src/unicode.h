@@ -0,0 +1,42 @@
+#pragma once
+#include <stdint.h>
+
+// UTF-8 decoding and the identifier classes from UAX #31, used by the lexer once it
+// hits a byte >= 0x80. Pure ASCII input never gets here.
+
+struct CodePoint {
+    uint32_t value;
+    uint32_t len; // bytes, 0 if `p` doesn't start a valid sequence
+};
+
+// rejects overlong forms, surrogates and anything past U+10FFFF. Reads up to 4 bytes,
+// a truncated sequence at the end of a padded buffer fails on the zero padding.
+inline auto decode_utf8(const char* p) -> CodePoint {
+    const uint8_t* s = (const uint8_t*)p;
+    auto cont = [&](int i) { return (s[i] & 0xC0) == 0x80; };
+    uint8_t c = s[0];
+    if (c < 0x80) return {c, 1};
+    if (c < 0xC2) return {0, 0};
+    if (c < 0xE0) {
+        if (!cont(1)) return {0, 0};
+        return {(uint32_t)(c & 0x1F) << 6 | (s[1] & 0x3F), 2};
+    }
+    if (c < 0xF0) {
+        if (!cont(1) || !cont(2)) return {0, 0};
+        if (c == 0xE0 && s[1] < 0xA0) return {0, 0}; // overlong
+        if (c == 0xED && s[1] >= 0xA0) return {0, 0}; // surrogate
+        return {(uint32_t)(c & 0x0F) << 12 | (uint32_t)(s[1] & 0x3F) << 6 | (s[2] & 0x3F), 3};
+    }
+    if (c < 0xF5) {
+        if (!cont(1) || !cont(2) || !cont(3)) return {0, 0};
+        if (c == 0xF0 && s[1] < 0x90) return {0, 0}; // overlong
+        if (c == 0xF4 && s[1] >= 0x90) return {0, 0}; // > U+10FFFF
+        return {(uint32_t)(c & 0x07) << 18 | (uint32_t)(s[1] & 0x3F) << 12 |
+                    (uint32_t)(s[2] & 0x3F) << 6 | (s[3] & 0x3F),
+                4};
+    }
+    return {0, 0};
+}
+
+auto is_xid_start(uint32_t cp) -> bool;
+auto is_xid_continue(uint32_t cp) -> bool;
@@ -0,0 +1,118 @@
+#pragma once
+#include "ast.h"
+#include <algorithm>
+
+// Calls `f(child)` for every child of `node` in source order, missing children (0) are
+// skipped. The one place that knows where each tag keeps its children, see ast.h.
+template <typename F>
+[[gnu::always_inline]] inline void for_each_child(const Ast& ast, NodeIndex node, F&& f) {
+    NodeData data = ast.data(node);
+    switch (ast.tag(node)) {
+    case Ast_Identifier:
+    case Ast_StringLiteral:
+    case Ast_NumberLiteral:
+    case Ast_FloatLiteral:
+    case Ast_Bool_Not:
+    case Ast_Negation:
+    case Ast_Bit_Not:
+    case Ast_AddressOf:
+    case Ast_Error:
+    case Ast_LazyBody:
+        return;
+    case Ast_Pointer:
+    case Ast_ParamDecl:
+        if (data.lhs) f(data.lhs);
+        return;
+    case Ast_Root:
+    case Ast_ParamDeclList:
+    case Ast_Block:
+        for (NodeIndex child : ast.list(node)) {
+            if (child) f(child);
+        }
+        return;
+    case Ast_Call:
+        for (NodeIndex arg : ast.list(ast.extra<SubRange>(data.rhs))) {
+            if (arg) f(arg);
+        }
+        return;
+    case Ast_FnDecl: {
+        FnProto proto = ast.extra<FnProto>(data.lhs);
+        if (proto.params) f(proto.params);
+        if (proto.return_type) f(proto.return_type);
+        if (data.rhs) f(data.rhs);
+        return;
+    }
+    case Ast_VarDecl:
+    case Ast_ConstDecl: {
+        VarDeclInfo info = ast.extra<VarDeclInfo>(data.lhs);
+        if (info.type) f(info.type);
+        if (info.value) f(info.value);
+        return;
+    }
+    default:
+        // binary operators, Assign, FieldAccess, Array, If_Simple, SimpleLoop
+        if (data.lhs) f(data.lhs);
+        if (data.rhs) f(data.rhs);
+        return;
+    }
+}
+
+// Depth-first walk over an Ast with the hooks resolved at compile time (CRTP), so a pass
+// is one switch per node and its hooks get inlined, no virtual calls.
+//
+//     struct CountCalls : AstWalker<CountCalls> {
+//         uint32_t calls = 0;
+//         auto pre(NodeIndex node) -> bool { calls += ast.tag(node) == Ast_Call; return true; }
+//     };
+//     CountCalls pass = {{parser.ast}};
+//     pass.walk(0);
+//
+// pre() runs before the children and returning false skips them (the pass can still walk
+// some of them itself), post() runs after them either way. walk(0) walks the whole tree.
+//
+// Up to `max_recursion` levels deep the walk recurses, which is the fastest way through
+// the usual shallow tree. Deeper subtrees are walked with the nodes still to visit kept
+// on `pending` instead of the call stack, so no input nests deep enough to overflow it.
+template <typename Derived> struct AstWalker {
+    const Ast& ast;
+    // nodes to visit, and (with children_done set) nodes to call post() on
+    vector<NodeIndex> pending = {};
+    static constexpr uint32_t max_recursion = 256;
+    static constexpr NodeIndex children_done = 1u << 31;
+
+    auto pre(NodeIndex node) -> bool { return true; }
+    void post(NodeIndex node) {}
+
+    void walk(NodeIndex node) { visit(node, 0); }
+
+  private:
+    void visit(NodeIndex node, uint32_t depth) {
+        if (depth == max_recursion) return walk_deep(node);
+        Derived& self = static_cast<Derived&>(*this);
+        if (self.pre(node))
+            for_each_child(ast, node, [&](NodeIndex child) { visit(child, depth + 1); });
+        self.post(node);
+    }
+
+    // A walk() from a hook in here goes on top of the nodes this one has pending and
+    // returns once it is through its own.
+    void walk_deep(NodeIndex node) {
+        Derived& self = static_cast<Derived&>(*this);
+        size_t base = pending.size();
+        pending.push_back(node);
+        while (pending.size() > base) {
+            NodeIndex next = pending.back();
+            if (next & children_done) {
+                pending.pop_back();
+                self.post(next & ~children_done);
+                continue;
+            }
+            pending.back() = next | children_done;
+            if (!self.pre(next)) continue;
+            // pushed in source order, reversed so that the first child is on top
+            size_t first = pending.size();
+            for_each_child(ast, next, [&](NodeIndex child) { pending.push_back(child); });
+            if (pending.size() - first > 1) std::reverse(pending.begin() + first, pending.end());
+        }
+    }
+};
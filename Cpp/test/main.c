@@ -0,0 +1,374 @@
+#include "../src/lexer.h"
+#include "../src/out_buffer.h"
+#include "../src/parser.h"
+#include "../src/source.h"
+#include <algorithm>
+#include <dirent.h>
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/wait.h>
+using namespace std;
+
+// Regression tests, `make test` runs them on this directory. Every <name>.drg in it is
+// checked against the files next to it:
+//   <name>.out         what the compiler prints for it, stdout and stderr, and its exit
+//                      status. The same with --stream, whose window is far shorter than
+//                      the longer functions in here.
+//   <name>.edits       edits made one after the other, one per line, see read_edits()
+//   <name>.edits.out   what relex() and reparse() made of each of them: the tree, or the
+//                      syntax errors
+//   <name>.chunks.out  the tokens and comments of the file, and whether
+//                      tokenize_parallel() finds the same with the file cut into chunks
+//                      of a few bytes, so they start inside comments, strings and tokens
+// The last two only where there is one, an empty <name>.chunks.out asks for it. With
+// --update the expected files are written from what came out instead, to be looked over
+// in the diff.
+
+static void usage(const char* prog) {
+    fprintf(stdout, "Usage: \n");
+    fprintf(stdout, "\t%s [--update] <COMPILER> <TEST_DIR>\n", prog);
+    fprintf(stdout, "Exit status: \n");
+    fprintf(stdout, "\t0 all tests passed, 1 some didn't, 2 the directory couldn't be read\n");
+}
+
+static auto read_text(const string& path, string* text) -> bool {
+    FILE* file = fopen(path.c_str(), "rb");
+    if (!file) return false;
+    text->clear();
+    char buf[1 << 14];
+    size_t n;
+    while ((n = fread(buf, 1, sizeof buf, file)) > 0) text->append(buf, n);
+    fclose(file);
+    return true;
+}
+
+static auto write_text(const string& path, string_view text) -> bool {
+    FILE* file = fopen(path.c_str(), "wb");
+    if (!file) return false;
+    bool ok = fwrite(text.data(), 1, text.size(), file) == text.size();
+    return fclose(file) == 0 && ok;
+}
+
+// `text` with the escape sequences of terminal colors left out
+static auto without_colors(string_view text) -> string {
+    string out;
+    for (size_t i = 0; i < text.size(); i++) {
+        if (text[i] == '\x1b' && i + 1 < text.size() && text[i + 1] == '[') {
+            i = text.find('m', i);
+            if (i == string_view::npos) break;
+            continue;
+        }
+        out += text[i];
+    }
+    return out;
+}
+
+// What `compiler` prints for `name` in `dir` with `flags`, run from `dir` so the
+// messages have the file name without the path. Exit status last.
+static auto run_compiler(const string& compiler, const char* flags, const string& dir,
+                         const string& name) -> string {
+    string command = "cd '" + dir + "' && '" + compiler + "' " + flags + " '" + name + "' 2>&1";
+    FILE* pipe = popen(command.c_str(), "r");
+    if (!pipe) return "couldn't run " + compiler + "\n";
+    string out;
+    char buf[1 << 14];
+    size_t n;
+    while ((n = fread(buf, 1, sizeof buf, pipe)) > 0) out.append(buf, n);
+    int status = pclose(pipe);
+    out = without_colors(out);
+    int code = WIFEXITED(status) ? WEXITSTATUS(status) : -1;
+    return out + "exit status: " + to_string(code) + "\n";
+}
+
+static auto location(const LineTable& lines, ByteOffset offset) -> string {
+    Location loc = lines.location_of(offset);
+    return to_string(loc.line) + ":" + to_string(loc.column);
+}
+
+// `text` with newlines, tabs, quotes and backslashes escaped, between quotes
+static auto quoted(string_view text) -> string {
+    string out = "\"";
+    for (char c : text) {
+        if (c == '\n') out += "\\n";
+        else if (c == '\t') out += "\\t";
+        else if (c == '"' || c == '\\') out += '\\', out += c;
+        else out += c;
+    }
+    return out + "\"";
+}
+
+// `line:column message` for each syntax error, as drgfmt words them
+static auto error_lines(Parser& parser) -> string {
+    string out;
+    for (const Error& error : parser.errors) {
+        Location loc = parser.location_of(error.token);
+        out += to_string(loc.line) + ":" + to_string(loc.column) + ": ";
+        if (error.kind == error_expected_token) {
+            out += "expected ";
+            out += enum_to_str(error.expected);
+        } else {
+            out += error.msg;
+        }
+        out += "\n";
+    }
+    return out;
+}
+
+// the tree the compiler would print, or the syntax errors
+static auto tree_or_errors(Parser& parser) -> string {
+    if (parser.has_errors()) return error_lines(parser);
+    OutBuffer out;
+    parser.emit_ast(out, Emit_Tree);
+    return out.bytes;
+}
+
+// through start() and literal_token(), relex() may still owe either of them a shift
+static auto same_tokens(const TokenList& a, const TokenList& b) -> bool {
+    if (a.kinds != b.kinds || a.literal_values != b.literal_values) return false;
+    for (TokenIndex i = 0; i < a.size(); i++) {
+        if (a.start(i) != b.start(i)) return false;
+    }
+    for (uint32_t j = 0; j < a.literal_tokens.size(); j++) {
+        if (a.literal_token(j) != b.literal_token(j)) return false;
+    }
+    return true;
+}
+
+struct Edit {
+    uint32_t line, column, removed;
+    string inserted;
+};
+
+// One edit per line: `<line>:<column> <removed> "<inserted>"`, the position in the text
+// as the edits before left it, `removed` in bytes and `inserted` with \n, \t, \\ and \"
+// escapes. Lines starting with `#` say what the next edit is about.
+static auto read_edits(string_view text, vector<Edit>* edits) -> bool {
+    while (!text.empty()) {
+        size_t end = text.find('\n');
+        string_view line = text.substr(0, end);
+        text.remove_prefix(end == string_view::npos ? text.size() : end + 1);
+        if (line.empty() || line[0] == '#') continue;
+
+        Edit edit = {};
+        string copy(line);
+        int used = 0;
+        if (sscanf(copy.c_str(), "%u:%u %u %n", &edit.line, &edit.column, &edit.removed,
+                   &used) != 3 ||
+            copy[used] != '"')
+            return false;
+        size_t i = used + 1;
+        for (; i < copy.size() && copy[i] != '"'; i++) {
+            if (copy[i] != '\\' || i + 1 == copy.size()) {
+                edit.inserted += copy[i];
+                continue;
+            }
+            char c = copy[++i];
+            edit.inserted += c == 'n' ? '\n' : c == 't' ? '\t' : c;
+        }
+        if (i == copy.size()) return false;
+        edits->push_back(edit);
+    }
+    return true;
+}
+
+// The edits applied to `contents` one at a time, each relexed and reparsed. Besides the
+// tree, says when the tokens or the tree aren't what lexing and parsing the edited text
+// from scratch gives.
+static auto run_edits(string_view contents, const vector<Edit>& edits) -> string {
+    EditableSource source(contents);
+    Parser parser(source.view());
+    parser.parseRoot();
+    string out;
+    for (uint32_t i = 0; i < edits.size(); i++) {
+        const Edit& e = edits[i];
+        LineTable lines(source.view());
+        uint32_t line = std::clamp<uint32_t>(e.line, 1, lines.line_starts.size());
+        uint32_t offset = std::min(lines.line_starts[line - 1] + e.column - 1, source.size());
+        SourceEdit edit = {offset, std::min(e.removed, source.size() - offset), e.inserted};
+        source.apply(edit);
+
+        Reparsed result = parser.reparse(source.view(), edit);
+        out += "edit " + to_string(i + 1) + ": " + to_string(e.line) + ":" +
+               to_string(e.column) + " -" + to_string(e.removed) + " +" + quoted(e.inserted);
+        out += result.kind == Ast_None   ? ", whole file parsed again\n"
+               : result.kind == Ast_Root ? ", top level statements parsed again\n"
+                                         : ", block parsed again\n";
+        string tree = tree_or_errors(parser);
+        Parser expected(source.view());
+        expected.parseRoot();
+        if (!same_tokens(parser.tokens, expected.tokens))
+            out += "tokens differ from lexing the whole file\n";
+        if (tree != tree_or_errors(expected)) out += "tree differs from parsing the whole file\n";
+        out += tree;
+    }
+    return out;
+}
+
+// what `tokens` and `comments` hold, one per line, literals with their value
+static auto dump_tokens(string_view source, const TokenList& tokens,
+                        const CommentTable& comments) -> string {
+    LineTable lines(source);
+    string out;
+    char number[32];
+    for (TokenIndex i = 0; i < tokens.size(); i++) {
+        TokenKind kind = tokens.kind(i);
+        out += location(lines, tokens.start(i)) + " " + enum_to_str(kind);
+        if (kind == Tok_Identifier) {
+            out += " ";
+            out += identifier_pool.get(tokens.literal(i));
+        } else if (kind == Tok_StringLiteral) {
+            out += " " + quoted(string_pool.get(tokens.literal(i)));
+        } else if (kind == Tok_NumberLiteral) {
+            out += " " + to_string(tokens.literal(i));
+        } else if (kind == Tok_FloatLiteral) {
+            uint64_t bits = tokens.literal(i);
+            double value;
+            memcpy(&value, &bits, sizeof value);
+            snprintf(number, sizeof number, " %.17g", value);
+            out += number;
+        }
+        out += "\n";
+    }
+    for (const Comment& c : comments.comments) {
+        out += location(lines, c.start) + " comment " + quoted(source.substr(c.start, c.len));
+        out += "\n";
+    }
+    return out;
+}
+
+// The tokens tokenize() finds, and whether tokenize_parallel() finds the same with the
+// file cut into chunks of 8 bytes (a few tokens each), 24 and 64, where the cuts fall
+// elsewhere. Nothing the chunk lexers lexed and then dropped may be left in the pools.
+static auto run_chunks(string_view source) -> string {
+    CommentTable expected_comments = {Comments_All, {}};
+    TokenList expected = tokenize(source, &expected_comments);
+    string first = dump_tokens(source, expected, expected_comments);
+    string out = "tokenize():\n" + first;
+    uint32_t names = identifier_pool.size(), strings = string_pool.size();
+    for (uint32_t size : {8u, 24u, 64u}) {
+        CommentTable comments = {Comments_All, {}};
+        uint32_t jobs = source.size() / size + 1;
+        TokenList tokens = tokenize_parallel(source, jobs, &comments, size);
+        string dump = dump_tokens(source, tokens, comments);
+        out += "chunks of " + to_string(size) + " bytes: ";
+        out += dump == first ? "the same\n" : "different\n" + dump;
+    }
+    if (identifier_pool.size() != names || string_pool.size() != strings) {
+        out += to_string(identifier_pool.size() - names) + " names and " +
+               to_string(string_pool.size() - strings) + " strings interned from dropped text\n";
+    }
+    return out;
+}
+
+// compares `actual` with the file at `path` (or writes it there with --update), prints
+// the first line that differs
+static auto check(const string& path, const char* what, const string& actual, bool update)
+    -> bool {
+    if (update) {
+        if (write_text(path, actual)) return true;
+        printf("FAIL %s: couldn't write it\n", path.c_str());
+        return false;
+    }
+    string expected;
+    if (!read_text(path, &expected)) {
+        printf("FAIL %s: missing, --update writes it\n", path.c_str());
+        return false;
+    }
+    if (actual == expected) return true;
+    uint32_t line = 1;
+    size_t i = 0;
+    for (; i < actual.size() && i < expected.size() && actual[i] == expected[i]; i++) {
+        if (actual[i] == '\n') line++;
+    }
+    auto line_at = [&](const string& text) {
+        size_t begin = text.rfind('\n', i ? i - 1 : 0);
+        begin = begin == string::npos || i == 0 ? 0 : begin + 1;
+        size_t end = text.find('\n', begin);
+        return text.substr(begin, end == string::npos ? string::npos : end - begin);
+    };
+    printf("FAIL %s (%s), line %u\n", path.c_str(), what, line);
+    printf("  expected: %s\n", line_at(expected).c_str());
+    printf("  actual  : %s\n", line_at(actual).c_str());
+    return false;
+}
+
+int main(int argc, char** argv) {
+    bool update = false;
+    const char* compiler = nullptr;
+    const char* dir_name = nullptr;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--update") == 0) {
+            update = true;
+        } else if (argv[i][0] == '-') {
+            usage(argv[0]);
+            exit(2);
+        } else if (!compiler) {
+            compiler = argv[i];
+        } else {
+            dir_name = argv[i];
+        }
+    }
+    if (!dir_name) {
+        usage(argv[0]);
+        exit(2);
+    }
+    char compiler_path[PATH_MAX];
+    if (!realpath(compiler, compiler_path)) {
+        fprintf(stderr, "%s: not found\n", compiler);
+        exit(2);
+    }
+
+    string dir = dir_name;
+    DIR* d = opendir(dir.c_str());
+    if (!d) {
+        fprintf(stderr, "%s: couldn't open directory\n", dir.c_str());
+        exit(2);
+    }
+    vector<string> names;
+    while (dirent* entry = readdir(d)) {
+        string_view name = entry->d_name;
+        if (name.size() > 4 && name.ends_with(".drg"))
+            names.emplace_back(name.substr(0, name.size() - 4));
+    }
+    closedir(d);
+    std::sort(names.begin(), names.end());
+
+    uint32_t failed = 0, checks = 0;
+    string text;
+    for (const string& name : names) {
+        string base = dir + "/" + name;
+        string full = run_compiler(compiler_path, "", dir, name + ".drg");
+        string stream = run_compiler(compiler_path, "--stream", dir, name + ".drg");
+        bool ok = check(base + ".out", "compiler", full, update);
+        if (ok && !update) ok = check(base + ".out", "compiler --stream", stream, false);
+        checks++;
+
+        std::string error;
+        SourceBuffer source = read_file((base + ".drg").c_str(), &error);
+        if (read_text(base + ".edits", &text)) {
+            vector<Edit> edits;
+            if (!read_edits(text, &edits)) {
+                printf("FAIL %s.edits: a line isn't `<line>:<column> <removed> \"<text>\"`\n",
+                       base.c_str());
+                ok = false;
+            } else {
+                ok = check(base + ".edits.out", "edits", run_edits(source, edits), update) && ok;
+            }
+            checks++;
+        }
+        if (read_text(base + ".chunks.out", &text)) {
+            ok = check(base + ".chunks.out", "chunks", run_chunks(source), update) && ok;
+            checks++;
+        }
+        failed += !ok;
+    }
+    if (update) {
+        printf("%zu tests, expected outputs written\n", names.size());
+        return 0;
+    }
+    printf("%zu tests (%u checks): %s\n", names.size(), checks,
+           failed ? (to_string(failed) + " failed").c_str() : "all passed");
+    return failed ? 1 : 0;
+}
@@ -0,0 +1,64 @@
+#!/usr/bin/env python3
+# Writes src/unicode_tables.h, the XID_Start / XID_Continue tables used by the lexer.
+# The Unicode version is whatever python's unicodedata ships with.
+#
+#   python3 tools/gen_unicode_tables.py > src/unicode_tables.h
+
+import sys
+import unicodedata
+
+BLOCK = 256  # code points per second level block
+
+
+def main():
+    limit = 0x110000
+    start = [False] * limit
+    cont = [False] * limit
+    for cp in range(limit):
+        if 0xD800 <= cp < 0xE000:
+            continue
+        c = chr(cp)
+        # str.isidentifier() is XID_Start followed by XID_Continue* (plus '_')
+        start[cp] = c.isidentifier()
+        cont[cp] = ("a" + c).isidentifier()
+
+    last = max(cp for cp in range(limit) if cont[cp] or start[cp])
+    block_count = last // BLOCK + 1
+
+    blocks = {(0,) * 8: 0}  # the empty block comes first
+    index = []
+    for b in range(block_count):
+        words = []
+        for bits in (start, cont):
+            for w in range(4):
+                word = 0
+                for i in range(64):
+                    if bits[b * BLOCK + w * 64 + i]:
+                        word |= 1 << i
+                words.append(word)
+        index.append(blocks.setdefault(tuple(words), len(blocks)))
+    assert len(blocks) <= 256
+
+    out = sys.stdout
+    out.write("#pragma once\n")
+    out.write("// generated by tools/gen_unicode_tables.py from Unicode %s, do not edit\n"
+              % unicodedata.unidata_version)
+    out.write("#include <stdint.h>\n\n")
+    out.write("constexpr uint32_t xid_block_shift = 8;\n")
+    out.write("constexpr uint32_t xid_block_count = %d; // code points past this have no XID\n\n"
+              % block_count)
+    out.write("// first level: code point >> 8 -> block\n")
+    out.write("static const uint8_t xid_block_index[xid_block_count] = {\n")
+    for i in range(0, len(index), 16):
+        out.write("    " + ", ".join("%3d" % v for v in index[i:i + 16]) + ",\n")
+    out.write("};\n\n")
+    out.write("// second level: 256 bit XID_Start bitmap then 256 bit XID_Continue bitmap\n")
+    out.write("static const uint64_t xid_blocks[%d][8] = {\n" % len(blocks))
+    for words in sorted(blocks, key=blocks.get):
+        out.write("    {" + ", ".join("0x%016x" % w for w in words[:4]) + ",\n")
+        out.write("     " + ", ".join("0x%016x" % w for w in words[4:]) + "},\n")
+    out.write("};\n")
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,26 @@
+#pragma once
+
+// The keywords and the perfect hash both frontends classify identifiers with, over
+// (first byte, last byte, length), all of which the lexer has once an identifier is scanned.
+// Cpp/src/keywords.h and C/src/keywords.h build their lookup from this list and each fails
+// to compile on a collision. Plain C, included from C23 and from C++.
+
+#define KEYWORD_TABLE_SIZE 32u
+
+#define KEYWORD_HASH(first, last, len)                                                        \
+    (((unsigned)(unsigned char)(first) * 3u + (unsigned)(unsigned char)(last) * 15u +       \
+      (unsigned)(len)) &                                                                    \
+     (KEYWORD_TABLE_SIZE - 1))
+
+// X(text, kind, first char, last char). The chars are spelled out since C can't take them
+// from the string in a case label, Cpp/src/keywords.h checks they match. `kind` is the
+// TokenKind, named the same in both frontends.
+#define KEYWORD_LIST(X)                                                                       \
+    X("fn", Tok_Keyword_fn, 'f', 'n')                                                         \
+    X("pub", Tok_Keyword_pub, 'p', 'b')                                                       \
+    X("const", Tok_Keyword_const, 'c', 't')                                                   \
+    X("var", Tok_Keyword_var, 'v', 'r')                                                       \
+    X("return", Tok_Keyword_return, 'r', 'n')                                                 \
+    X("if", Tok_Keyword_if, 'i', 'f')                                                         \
+    X("for", Tok_Keyword_for, 'f', 'r')                                                       \
+    X("while", Tok_Keyword_while, 'w', 'e')
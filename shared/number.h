@@ -0,0 +1,243 @@
+#pragma once
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Number literal decoding, done once by the lexer so nothing after it has to look
+// at the digits again. Shared by both frontends, plain C that also compiles as C++.
+//
+//   123  1_000_000  0xFF_FF  0b1010     integers, up to 2^64 - 1
+//   1.5  2e10  6.022_140e+23            floats, decoded to the nearest double
+//
+// A literal running into letters (`12ab`, `0b12`) or one too large for 64 bits
+// is reported as malformed / overflow and the lexer turns it into Tok_Invalid.
+
+typedef enum NumberKind {
+    Number_Int,
+    Number_Float,
+    Number_Overflow,
+    Number_Malformed,
+} NumberKind;
+
+typedef struct NumberParse {
+    uint32_t len; // bytes consumed
+    NumberKind kind;
+    uint64_t bits; // the integer, or the bits of the double for Number_Float
+} NumberParse;
+
+static inline double num_bits_to_double(uint64_t bits) {
+    double d;
+    memcpy(&d, &bits, sizeof(d));
+    return d;
+}
+
+static inline uint64_t num_double_to_bits(double d) {
+    uint64_t bits;
+    memcpy(&bits, &d, sizeof(bits));
+    return bits;
+}
+
+static inline bool num_is_digit(char c) { return c >= '0' && c <= '9'; }
+
+static inline bool num_is_ident(char c) {
+    return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || num_is_digit(c) || c == '_';
+}
+
+static inline int num_hex_value(char c) {
+    if (num_is_digit(c)) return c - '0';
+    c |= 0x20;
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    return -1;
+}
+
+//
+// SWAR, 8 decimal digits per step
+//
+
+// the next 8 bytes with the first one in the lowest byte
+static inline uint64_t num_load8(const char* p) {
+    uint64_t v;
+    memcpy(&v, p, 8);
+#if __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+    v = __builtin_bswap64(v);
+#endif
+    return v;
+}
+
+// zero for bytes in '0'..'9' (0x30..0x39): the high nibble is 3 and adding 6 doesn't carry
+// out of it. Past the first non zero byte the result is garbage, which is all we need.
+static inline uint64_t num_non_digit_bytes(uint64_t v) {
+    return ((v & 0xF0F0F0F0F0F0F0F0) ^ 0x3030303030303030) |
+           (((v + 0x0606060606060606) & 0xF0F0F0F0F0F0F0F0) ^ 0x3030303030303030);
+}
+
+// pairs of digits, then pairs of pairs, then the two halves, three multiplies in total
+static inline uint32_t num_parse_eight_digits(uint64_t v) {
+    v -= 0x3030303030303030;
+    v = v * 10 + (v >> 8);
+    v = ((v & 0x000000FF000000FF) * 0x000F424000000064 +
+         ((v >> 16) & 0x000000FF000000FF) * 0x0000271000000001) >>
+        32;
+    return (uint32_t)v;
+}
+
+static const uint64_t num_powers_of_ten[] = {
+    1, 10, 100, 1000, 10000, 100000, 1000000, 10000000, 100000000,
+};
+
+typedef struct NumDigitRun {
+    const char* end;
+    uint64_t value;
+    uint32_t count; // digits read, separators not included
+    bool overflow;
+} NumDigitRun;
+
+// [0-9] with single '_' between digits, up to 8 digits per step. Shorter runs are
+// shifted up and padded with leading '0's so they go through the same multiplies.
+static inline NumDigitRun num_scan_decimal(const char* p, uint64_t value) {
+    NumDigitRun run = {p, value, 0, false};
+    while (true) {
+        uint64_t chunk = num_load8(run.end);
+        uint64_t other = num_non_digit_bytes(chunk);
+        uint32_t n = other ? __builtin_ctzll(other) >> 3 : 8;
+        if (n) {
+            if (n < 8) chunk = chunk << (64 - 8 * n) | (0x3030303030303030 >> 8 * n);
+            if (__builtin_mul_overflow(run.value, num_powers_of_ten[n], &run.value) ||
+                __builtin_add_overflow(run.value, num_parse_eight_digits(chunk), &run.value))
+                run.overflow = true;
+            run.end += n;
+            run.count += n;
+            if (n == 8) continue;
+        }
+        if (run.end[0] != '_' || !num_is_digit(run.end[1])) return run;
+        run.end++;
+    }
+}
+
+//
+// Integers
+//
+
+static inline NumberParse num_finish(const char* start, const char* p, NumberKind kind,
+                                     uint64_t bits) {
+    // `12ab`, `0x1g`: eat the rest so the error covers the whole thing
+    if (num_is_ident(*p)) {
+        while (num_is_ident(*p)) p++;
+        kind = Number_Malformed;
+    }
+    NumberParse num = {(uint32_t)(p - start), kind, bits};
+    return num;
+}
+
+static inline NumberParse num_parse_radix(const char* start, uint32_t shift) {
+    const char* p = start + 2;
+    uint64_t value = 0;
+    bool overflow = false;
+    bool any = false;
+    int max_digit = (1 << shift) - 1;
+    while (true) {
+        int d = num_hex_value(*p);
+        if (d >= 0 && d <= max_digit) {
+            if (value >> (64 - shift)) overflow = true;
+            value = value << shift | d;
+            any = true;
+            p++;
+        } else if (*p == '_' && any && num_hex_value(p[1]) >= 0 &&
+                   num_hex_value(p[1]) <= max_digit) {
+            p++;
+        } else {
+            break;
+        }
+    }
+    if (!any) return num_finish(start, start + 2, Number_Malformed, 0);
+    return num_finish(start, p, overflow ? Number_Overflow : Number_Int, value);
+}
+
+//
+// Floats
+//
+
+static const double num_exact_powers_of_ten[] = {
+    1e0,  1e1,  1e2,  1e3,  1e4,  1e5,  1e6,  1e7,  1e8,  1e9,  1e10, 1e11,
+    1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22,
+};
+
+// strtod doesn't know about '_', copy the literal without them
+static inline double num_slow_path(const char* start, const char* end) {
+    char stack[128];
+    size_t len = end - start;
+    char* buf = len < sizeof(stack) ? stack : (char*)malloc(len + 1);
+    size_t n = 0;
+    for (const char* p = start; p < end; p++) {
+        if (*p != '_') buf[n++] = *p;
+    }
+    buf[n] = 0;
+    double d = strtod(buf, NULL);
+    if (buf != stack) free(buf);
+    return d;
+}
+
+// `mantissa * 10^exponent`, exact when both fit in a double (Clinger's fast path),
+// which covers nearly every literal people write. Everything else goes to strtod.
+static inline double num_decode_float(const char* start, const char* end, NumDigitRun mantissa,
+                                      int64_t exponent) {
+    if (!mantissa.overflow && mantissa.value <= (1ull << 53)) {
+        double m = (double)mantissa.value;
+        if (mantissa.value == 0) return 0.0;
+        if (exponent >= 0 && exponent <= 22) return m * num_exact_powers_of_ten[exponent];
+        if (exponent < 0 && exponent >= -22) return m / num_exact_powers_of_ten[-exponent];
+        // 1e30 is 1 * 10^8 * 10^22, both exact as long as the first product is
+        if (exponent > 22 && exponent <= 22 + 15) {
+            double scaled = m * num_exact_powers_of_ten[exponent - 22];
+            if (scaled <= (double)(1ull << 53)) return scaled * num_exact_powers_of_ten[22];
+        }
+    }
+    return num_slow_path(start, end);
+}
+
+// `p` points at the first digit and must be followed by zero padding,
+// up to 8 bytes past the literal are read at once.
+static inline NumberParse parse_number(const char* p) {
+    const char* start = p;
+    if (p[0] == '0') {
+        char prefix = p[1] | 0x20;
+        if (prefix == 'x') return num_parse_radix(start, 4);
+        if (prefix == 'b') return num_parse_radix(start, 1);
+    }
+
+    NumDigitRun run = num_scan_decimal(p, 0);
+    p = run.end;
+
+    bool is_float = false;
+    int64_t exponent = 0;
+    // `1.5` but not `1..5` or `1.foo`
+    if (p[0] == '.' && num_is_digit(p[1])) {
+        is_float = true;
+        NumDigitRun fraction = num_scan_decimal(p + 1, run.value);
+        fraction.overflow |= run.overflow;
+        exponent = -(int64_t)fraction.count;
+        run = fraction;
+        p = run.end;
+    }
+    if ((p[0] | 0x20) == 'e') {
+        const char* q = p + 1;
+        bool negative = *q == '-';
+        if (*q == '+' || *q == '-') q++;
+        if (num_is_digit(*q)) {
+            is_float = true;
+            int64_t e = 0;
+            for (; num_is_digit(*q) || (*q == '_' && num_is_digit(q[1])); q++) {
+                if (*q != '_' && e < 100000) e = e * 10 + (*q - '0');
+            }
+            exponent += negative ? -e : e;
+            p = q;
+        }
+    }
+
+    if (!is_float) {
+        return num_finish(start, p, run.overflow ? Number_Overflow : Number_Int, run.value);
+    }
+    double d = num_decode_float(start, p, run, exponent);
+    return num_finish(start, p, Number_Float, num_double_to_bits(d));
+}